@@ -36,6 +36,7 @@
 
 #include <algorithm>
 #include <array>
+#include <limits>
 #include "absl/base/internal/raw_logging.h"
 #include "absl/base/internal/spinlock.h"
 
@@ -28,6 +28,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <type_traits>
 #include <functional>
 
@@ -260,7 +261,7 @@ private:
 		m_ManagerFctPtr = other.m_ManagerFctPtr;
 	}
 
-	constexpr void* data() noexcept { return &m_Data; }
+	void* data() noexcept { return &m_Data; }
 	constexpr const void* data() const noexcept { return &m_Data; }
 
 	using CompatibleFunctionPointer = RetT(*)(ArgsT...);
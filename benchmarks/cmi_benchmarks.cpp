@@ -0,0 +1,390 @@
+#include "cmi/CAN.h"
+#include "cmi/CAN_Interface.h"
+#include "cmi/CAN_driver.h"
+#include "cmi/CO301_interface.h"
+#include "cmi/ObjectDictionary.h"
+#include "OS/Time.h"
+#include "OS/MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+using namespace CanMoveIt;
+
+// Benchmark of the parser and of the lookup of the ObjectsDictionary.
+// If a CAN driver is available (use the virtual one: libdriver_virtual), it also measures the
+// latency of the dispatch of the received frames and the throughput of the PDO decoder.
+// Usage: cmi_benchmarks [file.eds] [rounds] [can_driver]
+// The defaults are the files of the build tree (see benchmarks/CMakeLists.txt).
+
+#ifndef BENCHMARK_EDS_FILE
+#define BENCHMARK_EDS_FILE "../etc/ingenia_venus.eds"
+#endif
+
+#ifndef BENCHMARK_CACHE_DIR
+#define BENCHMARK_CACHE_DIR "."
+#endif
+
+#ifndef VIRTUAL_CAN_DRIVER
+#define VIRTUAL_CAN_DRIVER NULL
+#endif
+
+const int DEFAULT_ROUNDS = 1000;
+const int PARSE_ROUNDS   = 100;
+
+struct BenchmarkResult
+{
+    const char* name;
+    int64_t     usec;
+    uint64_t    checksum; // prevents the compiler from removing the loop.
+};
+
+static void printResult( const BenchmarkResult& res, uint64_t lookups )
+{
+    printf("%-34s %8lld usec   %7.1f nsec/lookup   (checksum %llu)\n",
+           res.name, (long long)res.usec,
+           1000.0 * (double)res.usec / (double)lookups,
+           (unsigned long long)res.checksum );
+}
+
+static void printThroughput( const char* name, int64_t usec, size_t bytes, int rounds )
+{
+    const double megabytes = (double)bytes * rounds / (1024.0 * 1024.0);
+    printf("%-34s %8lld usec   %7.1f MB/s   (%.1f usec/file)\n",
+           name, (long long)usec,
+           megabytes / ( (double)usec * 1e-6 ),
+           (double)usec / rounds );
+}
+
+static void printLatency( const char* name, std::vector<int64_t>& nsec )
+{
+    std::sort( nsec.begin(), nsec.end() );
+    printf("%-34s p50 %7.1f usec   p99 %7.1f usec   max %8.1f usec\n", name,
+           1e-3 * nsec[ nsec.size() / 2 ],
+           1e-3 * nsec[ nsec.size() * 99 / 100 ],
+           1e-3 * nsec.back() );
+}
+
+// Time between CANPort::send on one node and the execution of the callback on the other one.
+// Each frame carries the time it was sent; the next frame is sent once the previous one arrived.
+struct DispatchProbe
+{
+    std::vector<int64_t> latency_nsec;
+    std::atomic<int>     received;
+
+    void onFrame( const CanMessage& msg )
+    {
+        int64_t sent;
+        memcpy( &sent, msg.data, sizeof(sent) );
+        const int index = received.load();
+        if( index < (int)latency_nsec.size() )
+        {
+            latency_nsec[index] = GetTimeNow().time_since_epoch().count() - sent;
+        }
+        received++;
+    }
+
+    void run( CANPort* sender, int frames )
+    {
+        latency_nsec.assign( frames, 0 );
+        received = 0;
+        for (int i=0; i<frames; i++ )
+        {
+            CanMessage msg;
+            msg.cob_id = 0x181;
+            msg.len    = 8;
+            const int64_t now = GetTimeNow().time_since_epoch().count();
+            memcpy( msg.data, &now, sizeof(now) );
+            sender->send( &msg );
+            while( received.load() <= i ) { std::this_thread::yield(); }
+        }
+    }
+};
+
+static void benchmarkDispatch( const char* driver, int frames )
+{
+    LoadCanDriver( driver );
+    CANPortPtr receiver = openCanPort( "eds_parser_bench", "1M" );
+    CANPortPtr sender( new CANPort );
+    sender->open( "eds_parser_bench", "1M" );
+
+    // some subscribers that don't match, as a device would have.
+    std::vector<absl::any> others;
+    for (uint16_t node = 2; node < 42; node++ )
+    {
+        others.push_back( receiver->subscribeCallback( [](const CanMessage&) {}, 0x7F, node ) );
+    }
+
+    DispatchProbe probe;
+    absl::any sub = receiver->subscribeCallback( std::bind( &DispatchProbe::onFrame, &probe, std::placeholders::_1 ), 0x7FF, 0x181 );
+
+    printf("------ CANPort dispatch: %d frames ------------\n", frames );
+    probe.run( sender.get(), frames );
+    printLatency( "dispatch", probe.latency_nsec );
+
+    // another thread subscribes and unsubscribes continuously.
+    std::atomic<bool> churn( true );
+    std::thread churn_thread( [&receiver, &churn]()
+    {
+        while( churn )
+        {
+            absl::any id = receiver->subscribeCallback( [](const CanMessage&) {}, 0x7FF, 0x281 );
+            receiver->unsubscribeCallback( id );
+        }
+    });
+    probe.run( sender.get(), frames );
+    churn = false;
+    churn_thread.join();
+    printLatency( "dispatch (subscriptions churn)", probe.latency_nsec );
+
+    receiver->unsubscribeCallback( sub );
+    for (auto& id: others) { receiver->unsubscribeCallback( id ); }
+    sender->close();
+    receiver->close();
+}
+
+// Minimal slave for CO301_Interface::init and pdoMapping: every upload returns 0 (but the
+// device type) and every download is confirmed.
+static void answerSdo( CANPort* slave, const CanMessage& request )
+{
+    const uint8_t ccs = request.data[0] >> 5;
+    if( ccs != 1 && ccs != 2 ) return;
+
+    const uint32_t value = ( ccs == 2 && request.data[1] == 0x00 && request.data[2] == 0x10 ) ? 0x20192 : 0;
+    CanMessage answer;
+    answer.cob_id  = SDO_TX + request.getNode();
+    answer.len     = 8;
+    answer.data[0] = ( ccs == 2 ) ? 0x43 : 0x60;
+    answer.data[1] = request.data[1];
+    answer.data[2] = request.data[2];
+    answer.data[3] = request.data[3];
+    memcpy( &answer.data[4], &value, 4 );
+    slave->send( &answer );
+}
+
+// Frames per second decoded by CO301_Interface: a TPDO with two INT32 objects, sent by the slave
+// as fast as the virtual bus accepts them (it drops the frames beyond its queue size).
+static void benchmarkPdoDecoder( const char* driver, const char* filename, int frames )
+{
+    LoadCanDriver( driver );
+    CANPortPtr master = openCanPort( "eds_parser_pdo_bench", "1M" );
+    CANPortPtr slave( new CANPort );
+    slave->open( "eds_parser_pdo_bench", "1M" );
+
+    const uint8_t node = 1;
+    CANPort* slave_port = slave.get();
+    absl::any sub = slave->subscribeCallback( [slave_port](const CanMessage& m) { answerSdo( slave_port, m ); },
+                                              0x7FF, SDO_RX + node );
+
+    createObjectDictionary( filename, "eds_parser_bench" );
+    CO301_InterfacePtr device = create_CO301_Interface( master, node, "eds_parser_bench", 1 );
+
+    const ObjectID position( 0x6064, 0 );
+    const ObjectID velocity( 0x606C, 0 );
+    const ObjectKey not_found( ObjectsDictionary::NOT_FOUND );
+    if( device->tryFindObjectKey( position ) == not_found || device->tryFindObjectKey( velocity ) == not_found )
+    {
+        printf("------ PDO decoder: skipped, 0x6064 and 0x606C are not in %s\n", filename );
+    }
+    else{
+        PDO_MappingList mapping;
+        mapping.push_back( position );
+        mapping.push_back( velocity );
+        device->pdoMapping( PDO1_TX, mapping, 0x180 + node );
+        device->waitQueueEmpty( Milliseconds(1000) );
+
+        const ObjectKey key = device->findObjectKey( position );
+        const int WINDOW = 1024;
+
+        printf("------ PDO decoder: %d frames ------------\n", frames );
+        for (int inline_decoder = 0; inline_decoder < 2; inline_decoder++ )
+        {
+            device->enableInlineInterpreters( inline_decoder == 1 );
+            int32_t decoded = 0;
+            int32_t first   = 0;
+            device->getLastObjectReceived( key, &first );
+
+            const TimePoint t0 = GetTimeNow();
+            for (int32_t i = first + 1; i <= first + frames; i++ )
+            {
+                CanMessage msg;
+                msg.cob_id = 0x180 + node;
+                msg.len    = 8;
+                const int32_t opposite = -i;
+                memcpy( &msg.data[0], &i, 4 );
+                memcpy( &msg.data[4], &opposite, 4 );
+                slave->send( &msg );
+                while( i - decoded >= WINDOW )
+                {
+                    device->getLastObjectReceived( key, &decoded );
+                }
+            }
+            const TimePoint deadline = GetTimeNow() + std::chrono::seconds(5);
+            while( decoded != first + frames && GetTimeNow() < deadline )
+            {
+                device->getLastObjectReceived( key, &decoded );
+            }
+            const int64_t usec = ElapsedTime<Microseconds>( t0, GetTimeNow() ).count();
+            printf("%-34s %8lld usec   %9.0f frames/s%s\n",
+                   inline_decoder ? "PDO decode (receive thread)" : "PDO decode (executor)",
+                   (long long)usec, frames / ( (double)usec * 1e-6 ),
+                   decoded == first + frames ? "" : "   (frames lost)" );
+        }
+    }
+
+    // as in CMI::~CMI, the executor of the port is stopped before the interface is destroyed.
+    slave->unsubscribeCallback( sub );
+    slave->close();
+    master->close();
+    remove_CO301_Interface( 1 );
+}
+
+int main(int argc, char** argv)
+{
+    const char* filename = (argc > 1) ? argv[1] : BENCHMARK_EDS_FILE;
+    const int   rounds   = (argc > 2) ? atoi(argv[2]) : DEFAULT_ROUNDS;
+    const char* driver   = (argc > 3) ? argv[3] : VIRTUAL_CAN_DRIVER;
+
+    ObjectsDictionary dictionary;
+
+    try{
+        //------------------------------
+        // parser throughput
+        MappedFile file( filename );
+
+        TimePoint t0 = GetTimeNow();
+        for (int r=0; r<PARSE_ROUNDS; r++ )
+        {
+            dictionary.parseEDS( file.data(), file.size() );
+        }
+        printf("------ %s: %d entries, %d bytes ------------\n", filename, dictionary.size(), (int)file.size() );
+        printThroughput( "parseEDS (memory mapped)", ElapsedTime<Microseconds>( t0, GetTimeNow() ).count(),
+                         file.size(), PARSE_ROUNDS );
+
+        t0 = GetTimeNow();
+        for (int r=0; r<PARSE_ROUNDS; r++ )
+        {
+            std::ifstream stream( filename );
+            dictionary.parseEDS( stream );
+        }
+        printThroughput( "parseEDS (ifstream)", ElapsedTime<Microseconds>( t0, GetTimeNow() ).count(),
+                         file.size(), PARSE_ROUNDS );
+
+        // the first call writes the cache, the others load it.
+        dictionary.parseEDS( filename, BENCHMARK_CACHE_DIR );
+        t0 = GetTimeNow();
+        for (int r=0; r<PARSE_ROUNDS; r++ )
+        {
+            dictionary.parseEDS( filename, BENCHMARK_CACHE_DIR );
+        }
+        printThroughput( "parseEDS (binary cache)", ElapsedTime<Microseconds>( t0, GetTimeNow() ).count(),
+                         file.size(), PARSE_ROUNDS );
+
+        std::vector<ObjectID> ids;
+        for (int i=0; i<dictionary.size(); i++ )
+        {
+            ids.push_back( dictionary.getEntry( ObjectKey(i) ).id() );
+        }
+
+        // correctness first.
+        for (int i=0; i<dictionary.size(); i++ )
+        {
+            if( dictionary.find( ids[i].index(), ids[i].subindex() ) != ObjectKey(i) )
+            {
+                printf("find failed for [0x%X / 0x%X]\n", ids[i].index(), ids[i].subindex() );
+                return 1;
+            }
+        }
+        if( dictionary.tryFind( 0x0001, 0xFF ) != ObjectKey( ObjectsDictionary::NOT_FOUND ) )
+        {
+            printf("tryFind found an entry that doesn't exist\n");
+            return 1;
+        }
+
+        const uint64_t lookups = (uint64_t)rounds * ids.size();
+        BenchmarkResult res;
+
+        //------------------------------
+        // reference: binary search on the sorted ids (what find used to do, without the
+        // allocation of the temporary ObjectEntry).
+        std::vector<uint32_t> sorted_ids;
+        for (auto& id: ids) sorted_ids.push_back( id.get() );
+
+        res.name = "lower_bound";
+        res.checksum = 0;
+        TimePoint t1 = GetTimeNow();
+        for (int r=0; r<rounds; r++ )
+        {
+            for (auto& id: ids)
+            {
+                res.checksum += std::lower_bound( sorted_ids.begin(), sorted_ids.end(), id.get() ) - sorted_ids.begin();
+            }
+        }
+        res.usec = ElapsedTime<Microseconds>( t1, GetTimeNow() ).count();
+        printResult( res, lookups );
+
+        //------------------------------
+        std::map<uint32_t, uint16_t> my_map;
+        for (int i=0; i<dictionary.size(); i++ )
+        {
+            my_map.insert( std::make_pair( ids[i].get(), i ) ) ;
+        }
+
+        res.name = "std::map";
+        res.checksum = 0;
+        t1 = GetTimeNow();
+        for (int r=0; r<rounds; r++ )
+        {
+            for (auto& id: ids)
+            {
+                res.checksum += my_map.find( id.get() )->second;
+            }
+        }
+        res.usec = ElapsedTime<Microseconds>( t1, GetTimeNow() ).count();
+        printResult( res, lookups );
+
+        //------------------------------
+        res.name = "ObjectsDictionary::find";
+        res.checksum = 0;
+        t1 = GetTimeNow();
+        for (int r=0; r<rounds; r++ )
+        {
+            for (auto& id: ids)
+            {
+                res.checksum += dictionary.find( id.index(), id.subindex() );
+            }
+        }
+        res.usec = ElapsedTime<Microseconds>( t1, GetTimeNow() ).count();
+        printResult( res, lookups );
+
+        //------------------------------
+        // misses: the old find paid an exception for each of them.
+        res.name = "ObjectsDictionary::tryFind (miss)";
+        res.checksum = 0;
+        t1 = GetTimeNow();
+        for (int r=0; r<rounds; r++ )
+        {
+            for (auto& id: ids)
+            {
+                res.checksum += dictionary.tryFind( id.index(), 0xFF );
+            }
+        }
+        res.usec = ElapsedTime<Microseconds>( t1, GetTimeNow() ).count();
+        printResult( res, lookups );
+
+        //------------------------------
+        if( driver )
+        {
+            benchmarkDispatch( driver, 20 * rounds );
+            benchmarkPdoDecoder( driver, filename, 100 * rounds );
+        }
+    }
+    catch( std::exception& e)
+    {
+        printf("%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -264,6 +264,10 @@ Device Type              | 1000h   | 0h        | UNSIGNED32 | RO       | no
 * would be possible to have the same node_ID repeated twice but on different networks; this makes impossible
 * to use node_ID as the unique identifier of a non-trivial Master.
 *
+* Each CanPort has its own thread to send the messages, handle the timeouts and interpret the replies of
+* its devices, therefore a busy network doesn't slow down the others. Add the attribute executor="shared"
+* to a <CanPort> to make it use the thread shared with all the other ports that do the same.
+*
 * For example the following configuration would be valid (two slaves with node 32 but located on two
 * different networks):
 *
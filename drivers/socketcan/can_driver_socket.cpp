@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <stdlib.h>
 #include <stddef.h>		/* for NULL */
 #include <errno.h>
+#include <vector>
 
 
 #ifdef RTCAN_SOCKET
@@ -188,6 +189,18 @@ CAN_Handle_t LIBAPI canOpen_driver (const char *busname, const char* baud_rate)
     }
 #endif
 
+#ifndef RTCAN_SOCKET
+    {
+        // ask the kernel to timestamp the received frames (CLOCK_REALTIME, see CAN_driver.h).
+        int enable_timestamp = 1;
+        err = CAN_SETSOCKOPT(fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                             &enable_timestamp, sizeof(enable_timestamp));
+        if (err) {
+            fprintf(stderr, "setsockopt SO_TIMESTAMPNS: %d / %s\n", err, strerror (CAN_ERRNO (err)));
+        }
+    }
+#endif
+
     addr.can_family = AF_CAN;
     addr.can_ifindex = ifr.ifr_ifindex;
     err = CAN_BIND (fd, (struct sockaddr *) &addr, sizeof (addr));
@@ -246,12 +259,40 @@ static volatile bool _threadGoAway = false;
 
 
 /********* functions which permit to communicate with the board ****************/
-int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
+
+static void frameToCanMessage( struct can_frame const& frame, CanMessage * m )
+{
+    m->cob_id = frame.can_id & CAN_EFF_MASK;
+    m->len    = frame.can_dlc;
+    if (frame.can_id & CAN_RTR_FLAG)
+        m->rtr  = 1;
+    else
+        m->rtr  = 0;
+    memcpy (m->data, frame.data, 8);
+}
+
+#ifndef RTCAN_SOCKET
+/* Returns the RX timestamp attached by the kernel to the message, 0 if not available. */
+static uint64_t rxTimestamp( struct msghdr * msg )
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        }
+    }
+    return 0;
+}
+
+#define CONTROL_BUFFER_SIZE CMSG_SPACE(sizeof(struct timespec))
+#endif
+
+/* Returns 1 if fd is readable, 0 on timeout, -1 on error. */
+static int waitReadable( int fd )
 {
-    int fd = handle.fd;
-    int err = 0;
-    struct can_frame frame;
-    //----------------
     struct timeval timeout;
     timeout.tv_sec = 0;
     timeout.tv_usec = 100000;
@@ -263,10 +304,38 @@ int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
     int rc = select(fd+1, &readSet, NULL, NULL, &timeout);
     if (rc > 0)
     {
-        if (FD_ISSET(fd, &readSet))
-        {
-            err = CAN_RECV(fd, &frame, sizeof (frame), 0);
-        }
+        return FD_ISSET(fd, &readSet) ? 1 : 0;
+    }
+    return (rc == 0) ? 0 : -1;
+}
+
+int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
+{
+    int fd = handle.fd;
+    int err = 0;
+    struct can_frame frame;
+    //----------------
+#ifndef RTCAN_SOCKET
+    struct iovec iov;
+    struct msghdr msg;
+    char control[CONTROL_BUFFER_SIZE];
+
+    iov.iov_base = &frame;
+    iov.iov_len  = sizeof(frame);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+#endif
+    int rc = waitReadable(fd);
+    if (rc > 0)
+    {
+#ifndef RTCAN_SOCKET
+        err = recvmsg(fd, &msg, 0);
+#else
+        err = CAN_RECV(fd, &frame, sizeof (frame), 0);
+#endif
     }
     else{
         if (rc == 0) return 1;
@@ -280,35 +349,86 @@ int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
         return err;
     }
 
-    m->cob_id = frame.can_id & CAN_EFF_MASK;
-    m->len    = frame.can_dlc;
-    if (frame.can_id & CAN_RTR_FLAG)
-        m->rtr  = 1;
-    else
-        m->rtr  = 0;
-    memcpy (m->data, frame.data, 8);
-
+    frameToCanMessage( frame, m );
+#ifndef RTCAN_SOCKET
+    m->timestamp_usec = rxTimestamp( &msg );
+#endif
     return 0;
 }
 
+#ifndef RTCAN_SOCKET /* recvmmsg is not available in rtsocketcan */
+
+#define MAX_BATCH_SIZE 64
+
 /***************************************************************************/
-/*static*/ int LIBAPI canSend_driver( CAN_Handle_t  handle, CanMessage const * m)
+int LIBAPI canReceiveBatch_driver( CAN_Handle_t handle, CanMessage * buffer, int max_num )
 {
     int fd = handle.fd;
-    int err;
-    struct can_frame frame;
+    struct can_frame frames[MAX_BATCH_SIZE];
+    struct iovec     iovecs[MAX_BATCH_SIZE];
+    struct mmsghdr   msgs[MAX_BATCH_SIZE];
+    char             control[MAX_BATCH_SIZE][CONTROL_BUFFER_SIZE];
+
+    if (max_num > MAX_BATCH_SIZE) max_num = MAX_BATCH_SIZE;
+
+    int rc = waitReadable(fd);
+    if (rc <= 0)
+    {
+        return rc;
+    }
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * max_num );
+    for (int i = 0; i < max_num; i++)
+    {
+        iovecs[i].iov_base = &frames[i];
+        iovecs[i].iov_len  = sizeof(struct can_frame);
+        msgs[i].msg_hdr.msg_iov    = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control    = control[i];
+        msgs[i].msg_hdr.msg_controllen = CONTROL_BUFFER_SIZE;
+    }
+
+    // the socket is readable: take everything that is already queued, without blocking.
+    int num = recvmmsg(fd, msgs, max_num, MSG_DONTWAIT, NULL);
+    if (num < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        fprintf (stderr, "Recvmmsg failed: %d / %s\n", num, strerror (CAN_ERRNO (num)));
+        return -1;
+    }
 
-    frame.can_id = m->cob_id;
+    for (int i = 0; i < num; i++)
+    {
+        frameToCanMessage( frames[i], &buffer[i] );
+        buffer[i].timestamp_usec = rxTimestamp( &msgs[i].msg_hdr );
+    }
+    return num;
+}
+#endif
+
+/***************************************************************************/
+static void canMessageToFrame( CanMessage const * m, struct can_frame * frame )
+{
+    frame->can_id = m->cob_id;
 
-    if (frame.can_id >= 0x800)
-        frame.can_id |= CAN_EFF_FLAG;
+    if (frame->can_id >= 0x800)
+        frame->can_id |= CAN_EFF_FLAG;
 
-    frame.can_dlc = m->len;
+    frame->can_dlc = m->len;
 
     if (m->rtr)
-        frame.can_id |= CAN_RTR_FLAG;
+        frame->can_id |= CAN_RTR_FLAG;
     else
-        memcpy (frame.data, m->data, 8);
+        memcpy (frame->data, m->data, 8);
+}
+
+/*static*/ int LIBAPI canSend_driver( CAN_Handle_t  handle, CanMessage const * m)
+{
+    int fd = handle.fd;
+    int err;
+    struct can_frame frame;
+
+    canMessageToFrame( m, &frame );
 
     err = CAN_SEND (fd, &frame, sizeof (frame), 0);
     if (err < 0)
@@ -319,6 +439,60 @@ int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
     return 0;
 }
 
+#ifndef RTCAN_SOCKET /* sendmmsg is not available in rtsocketcan */
+/***************************************************************************/
+int LIBAPI canSendBatch_driver( CAN_Handle_t handle, CanMessage const * msgs, int num )
+{
+    int fd = handle.fd;
+    struct can_frame frames[MAX_BATCH_SIZE];
+    struct iovec     iovecs[MAX_BATCH_SIZE];
+    struct mmsghdr   mmsgs[MAX_BATCH_SIZE];
+
+    if (num > MAX_BATCH_SIZE) num = MAX_BATCH_SIZE;
+
+    memset(mmsgs, 0, sizeof(struct mmsghdr) * num );
+    for (int i = 0; i < num; i++)
+    {
+        canMessageToFrame( &msgs[i], &frames[i] );
+        iovecs[i].iov_base = &frames[i];
+        iovecs[i].iov_len  = sizeof(struct can_frame);
+        mmsgs[i].msg_hdr.msg_iov    = &iovecs[i];
+        mmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int sent = sendmmsg(fd, mmsgs, num, 0);
+    if (sent < 0)
+    {
+        fprintf (stderr, "Sendmmsg failed: %d / %s\n", sent, strerror (CAN_ERRNO (sent)));
+        return -1;
+    }
+    return sent;
+}
+#endif
+
+/***************************************************************************/
+int LIBAPI canSetFilters_driver( CAN_Handle_t handle, uint16_t const * masks, uint16_t const * frame_ids, int num )
+{
+    int fd = handle.fd;
+    std::vector<struct can_filter> filters( num );
+
+    for (int i = 0; i < num; i++)
+    {
+        // flags (EFF, RTR) are not part of the mask, as in the filtering done by CANPort.
+        filters[i].can_mask = masks[i] & CAN_SFF_MASK;
+        filters[i].can_id   = frame_ids[i] & filters[i].can_mask;
+    }
+
+    int err = CAN_SETSOCKOPT(fd, SOL_CAN_RAW, CAN_RAW_FILTER,
+                             num > 0 ? filters.data() : NULL,
+                             num * sizeof(struct can_filter));
+    if (err)
+    {
+        fprintf(stderr, "setsockopt CAN_RAW_FILTER: %d / %s\n", err, strerror (CAN_ERRNO (err)));
+        return err;
+    }
+    return 0;
+}
 
 /***************************************************************************/
 int LIBAPI canClose_driver(CAN_Handle_t handle)
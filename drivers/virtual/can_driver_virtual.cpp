@@ -0,0 +1,154 @@
+/*******************************************************
+ * Copyright (C) 2013-2014 Davide Faconti, Icarus Technology SL Spain>
+ * All Rights Reserved.
+ *
+ * This file is part of CAN/MoveIt Core library
+ *
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Icarus Technology SL Incorporated.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *******************************************************/
+
+/*
+ * In-process virtual CAN bus, used by the tests and by the benchmarks.
+ *
+ * Each call of canOpen_driver attaches a new node to the bus called busname (the bitrate is ignored).
+ * A frame sent by a node is received by all the other nodes of the same bus.
+ * handle.fd is an eventfd that is readable while the node has frames to be read, therefore the
+ * node can be used by the receive thread of CANPort as well as by the receive reactor.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+
+#include "cmi/CAN_driver.h"
+
+namespace {
+
+struct Node
+{
+    int                     fd;
+    std::string             busname;
+    std::mutex              mutex;
+    // allocated once: sending and receiving frames doesn't allocate.
+    boost::circular_buffer<CanMessage> rx_queue;
+};
+
+std::mutex                                    buses_mutex;
+std::map<std::string, std::vector<Node*> >    buses;
+// nodes are never deleted: a receive thread might still be waiting on a closed node.
+std::vector< std::unique_ptr<Node> >          all_nodes;
+
+// max number of frames queued by a node that nobody reads.
+const size_t MAX_QUEUE_SIZE = 4096;
+
+}
+
+/* Returns 0 if a message was read, 1 on timeout, -1 on error. */
+int LIBAPI canReceive_driver( CAN_Handle_t handle, CanMessage * m )
+{
+    Node* node = static_cast<Node*>( handle.vp );
+
+    struct pollfd pfd;
+    pfd.fd     = node->fd;
+    pfd.events = POLLIN;
+    int rc = poll( &pfd, 1, 100 );
+    if( rc == 0 ) return 1;
+    if( rc < 0 || (pfd.revents & POLLNVAL) ) return -1;
+
+    uint64_t count = 0;
+    if( read( node->fd, &count, sizeof(count) ) != sizeof(count) )
+    {
+        // another reader took it.
+        return ( errno == EAGAIN ) ? 1 : -1;
+    }
+
+    std::lock_guard<std::mutex> lock( node->mutex );
+    *m = node->rx_queue.front();
+    node->rx_queue.pop_front();
+    m->timestamp_usec = 0;
+    return 0;
+}
+
+int LIBAPI canSend_driver( CAN_Handle_t handle, CanMessage const * m )
+{
+    Node* sender = static_cast<Node*>( handle.vp );
+
+    std::lock_guard<std::mutex> bus_lock( buses_mutex );
+    for( Node* node: buses[ sender->busname ] )
+    {
+        if( node == sender ) continue;
+        {
+            std::lock_guard<std::mutex> lock( node->mutex );
+            if( node->rx_queue.full() ) continue; // overrun: the frame is lost.
+            node->rx_queue.push_back( *m );
+        }
+        const uint64_t one = 1;
+        if( write( node->fd, &one, sizeof(one) ) != sizeof(one) )
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+CAN_Handle_t LIBAPI canOpen_driver( const char *busname, const char* /*baud_rate*/ )
+{
+    CAN_Handle_t handle;
+    handle.fd = -1;
+    handle.vp = NULL;
+
+    int fd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE );
+    if( fd < 0 )
+    {
+        return handle;
+    }
+
+    std::unique_ptr<Node> node( new Node );
+    node->fd      = fd;
+    node->busname = busname;
+    node->rx_queue.set_capacity( MAX_QUEUE_SIZE );
+
+    std::lock_guard<std::mutex> bus_lock( buses_mutex );
+    buses[ node->busname ].push_back( node.get() );
+
+    handle.fd = fd;
+    handle.vp = node.get();
+    all_nodes.push_back( std::move(node) );
+    return handle;
+}
+
+int LIBAPI canClose_driver( CAN_Handle_t handle )
+{
+    Node* node = static_cast<Node*>( handle.vp );
+    if( !node ) return -1;
+
+    std::lock_guard<std::mutex> bus_lock( buses_mutex );
+    std::vector<Node*>& nodes = buses[ node->busname ];
+    nodes.erase( std::remove( nodes.begin(), nodes.end(), node ), nodes.end() );
+    return 0;
+}
+
+int LIBAPI canStatus_driver( CAN_Handle_t /*handle*/ )
+{
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <signal.h>
 #include "OS/Thread.h"
 #include "absl/types/any.h"
+#include "tinyxml2/inplace_function.h"
 
 namespace CanMoveIt 
 {
@@ -63,6 +64,9 @@ public:
     /// This is the type of accepted callbacks.
     typedef std::function<void(void)> Callback_t;
 
+    /// Callable stored in place (no heap allocation). Used by addImmediateTask.
+    typedef stdext::inplace_function<void(void), 48> Task_t;
+
     /// You get this handle when you call setAlarm. It can be used to delete an alarm using delAlarm.
     typedef  absl::any  Handle_t;
 
@@ -89,6 +93,14 @@ public:
 
     void addImmediateCallback(Callback_t cb );
 
+    /**
+     * @brief Same as addImmediateCallback, but the task is stored in a fixed size lock-free
+     * ring instead of being posted individually to the io_service. In steady state it doesn't
+     * allocate any memory, therefore it should be preferred in the code executed for each CAN frame.
+     * Tasks pushed by the same thread are executed in the same order.
+     */
+    void addImmediateTask(Task_t task );
+
     void flush_expired();
 
     void kill();
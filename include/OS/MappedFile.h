@@ -0,0 +1,37 @@
+#ifndef CMI_MappedFile_INCLUDED
+#define CMI_MappedFile_INCLUDED
+
+#include <cstddef>
+
+namespace CanMoveIt {
+
+/**
+ * Read-only memory mapping of an entire file.
+ * The content is available until the object is destroyed.
+ * The constructor throws std::runtime_error if the file can't be opened or mapped.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const char* filename);
+    ~MappedFile();
+
+    const char* data() const { return _data; }
+    size_t      size() const { return _size; }
+
+private:
+    /// MappedFile is NOT copiable
+    MappedFile(const MappedFile&);
+    MappedFile& operator = (const MappedFile&);
+
+    const char* _data;
+    size_t      _size;
+#ifdef WIN32
+    void*       _file;
+    void*       _mapping;
+#endif
+};
+
+} // namespace CanMoveIt
+
+#endif // CMI_MappedFile_INCLUDED
@@ -1,6 +1,7 @@
 #ifndef CMI_Thread_INCLUDED
 #define CMI_Thread_INCLUDED
 
+#include <functional>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -140,6 +141,9 @@ public:
     /// Returns the native thread ID for the current thread.
     static void setCurrentPriority(int prio,int policy = DEFAULT_POLICY );
 
+    /// Pin the current thread to a single CPU core.
+    static void setCurrentAffinity(int cpu);
+
 protected:
 
 
@@ -34,6 +34,8 @@
 namespace CanMoveIt
 {
 
+class AsyncManager;
+
 typedef std::function<void(const CanMessage &)> CanRcvCallback;
 typedef std::function<bool(const CanMessage &)> InterpreterCallback;
 
@@ -81,6 +83,17 @@ public:
      */
     int16_t send(CanMessage *m);
 
+    /**
+     * @brief Send a burst of CAN messages with a single call to the driver (if the driver supports it).
+     * The messages are transmitted in the same order they have in the array.
+     * @param msgs      Array of messages to send.
+     * @param num_msgs  Number of messages in the array.
+     * @return
+     * 		- 0 if all the messages were sent.
+     * 		- errorcode from the CAN driver otherwise. Some of the messages might have been sent already.
+     */
+    int16_t sendBatch(CanMessage *msgs, int num_msgs);
+
     /**
      * @brief Close a CAN port.
      * @return
@@ -119,9 +132,36 @@ public:
      * @brief Unsubscribe a callback.
      * It will be recognized among the registered callbacks using the mask and the frame_id used when
      * subscribeCallback was called.
+     * When this method returns, the callback is not being executed by the receive thread anymore
+     * (unless you call it from the callback itself).
      */
     void unsubscribeCallback(const absl::any &callback);
 
+    /**
+     * @brief Push the (mask, frame_id) pairs of all the subscribed callbacks into the driver,
+     * so that the frames nobody is interested in are discarded by the kernel (or by the hardware)
+     * instead of being received by this process.
+     * The filter is updated automatically by subscribeCallback and unsubscribeCallback.
+     * Disabled by default.
+     *
+     * @return false if the driver doesn't support filtering.
+     */
+    bool enableDriverFilter(bool enable);
+
+    /**
+     * @brief By default each port owns an AsyncManager (see executor()), so that the traffic
+     * of a bus doesn't delay the others. If shared is true, the port uses CMI::async_can instead,
+     * like all the other ports that do the same.
+     * Must be called before open().
+     */
+    void useSharedExecutor(bool shared);
+
+    /**
+     * @brief The AsyncManager used by the CanInterfaces of this port to schedule the transmission,
+     * the timeouts and the interpreters of the received messages.
+     */
+    AsyncManager* executor();
+
     void traceSetSize(uint32_t s);
 
     void traceEnable(bool enable);
@@ -151,11 +191,13 @@ typedef std::shared_ptr< CANPort > CANPortPtr;
  *
  * @param busname  The address used by you operative system to identify the hardware device.
  * @param bitrate   The bitrate should be either 1M, 500K, 250K, 125K, etc...
+ * @param shared_executor  If true, the port uses CMI::async_can instead of its own executor
+ *                         (see CANPort::useSharedExecutor). Ignored if the port is opened already.
  * @return
  * 		- 0 if succes
  * 		- errorcode from the CAN driver is returned if an error occurs. (if implemented in the CAN driver)
  */
-CANPortPtr openCanPort(const char* busname, const char* bitrate );
+CANPortPtr openCanPort(const char* busname, const char* bitrate, bool shared_executor = false );
 
 
 /**
@@ -178,6 +220,19 @@ int8_t UnLoadCanDriver();
  */
 void LoadCanDriver(const char* driver_name);
 
+/**
+ * @ingroup can_interface
+ * @brief Serve all the CAN ports with a single epoll reactor instead of one receive thread per port.
+ *
+ * Must be called before opening any CANPort. The driver must provide a pollable
+ * file descriptor in CAN_Handle_t::fd (like the socketcan one). Linux only.
+ *
+ * @param num_threads  Number of threads serving the reactor. A port is never read by two
+ *                     threads at the same time.
+ * @param first_cpu    If not negative, the i-th thread is pinned to the core (first_cpu + i).
+ */
+void enableCanReceiveReactor(int num_threads = 1, int first_cpu = -1);
+
 
 bool isCanReadThread();
 
@@ -60,10 +60,46 @@ namespace CanMoveIt {
  * next message to be sent.
  * This timeout can be modified using the method setReadTimeout.
  *
+ * The queue is actually made of several lanes (see TxLane). The messages of TX_LANE_REALTIME are sent
+ * even while the other lanes wait for an answer.
+ *
  *  When a message is received, the callback msgReceivedCallback is executed. The latter method
  *  takes care of dispatching the raw message to one or more callbacks with will do the actual interpretation of the message
  *  using the correct protocol.
  */
+/**
+ * @ingroup can_interface
+ * @brief Round trip time of the messages that wait for an answer (see CanInterface::getRttStatistics).
+ */
+struct RttStatistics
+{
+    Microseconds last;            /**< Last sample.*/
+    Microseconds smoothed;        /**< Exponentially smoothed round trip time.*/
+    Microseconds variation;       /**< Smoothed mean deviation of the samples.*/
+    Microseconds min;
+    Microseconds max;
+    uint32_t     num_samples;
+    uint32_t     num_timeouts;    /**< Number of answers that were not received in time.*/
+    Microseconds current_timeout; /**< Timeout currently used by the queue.*/
+
+    RttStatistics(): last(0), smoothed(0), variation(0), min(0), max(0),
+        num_samples(0), num_timeouts(0), current_timeout(0) {}
+};
+
+/**
+ * @ingroup can_interface
+ * @brief Transmission lanes of CanInterface, in order of priority.
+ */
+typedef enum{
+    /** Cyclic control frames (SYNC, RPDO). Never blocked by a message waiting for an answer: use it only for
+     *  frames whose order with respect to the other lanes doesn't matter.*/
+    TX_LANE_REALTIME,
+    /** Default lane (for instance SDO).*/
+    TX_LANE_NORMAL,
+    /** Bulk transfers, served only when TX_LANE_NORMAL is empty.*/
+    TX_LANE_BACKGROUND
+} TxLane;
+
 class CanInterface
 {
 
@@ -80,19 +116,45 @@ public:
     ~CanInterface();
 
     /** Push a message into the queue . Note that the message isn't delivered immediately. This methos is NON blocking.
-    * You can additionally decide to push the message in the fron of the queue instead of the back (default behaviour).
+    * The message goes to TX_LANE_NORMAL, in the same order it was pushed.
+    * You can additionally decide to push the message in the fron of the queue instead of the back (default behaviour):
+    * it will be sent before the other messages of TX_LANE_NORMAL and TX_LANE_BACKGROUND.
+    * @return 1 if the message was queued, 0 if the queue is full.
     */
     virtual int pushMessage(const CanMessage & m, bool push_front = false);
 
-    /** Set the value of the default timeout to be used when the queue is waiting for an answer. */
+    /** Push a message into a specific transmission lane. See TxLane.*/
+    int pushMessage(const CanMessage & m, TxLane lane);
+
+    /** Set a fixed timeout to be used when the queue is waiting for an answer. It disables the adaptive timeout. */
     void setReadTimeout(Microseconds usec);
 
-    /** Get the value of the default timeout to be used when the queue is waiting for an answer. */
+    /**
+     * @brief Derive the timeout from the measured round trip time of the answers, like TCP does
+     * (smoothed round trip time plus four times its variation, doubled after each timeout).
+     * It is disabled by default (fixed timeout of 200 ms).
+     *
+     * Choose the floor larger than the slowest answer of the device (for instance a store to flash):
+     * all the SDO answers of a node share the same COB-ID, therefore an answer received after the timeout
+     * is taken as the answer of the next request.
+     *
+     * @param floor    Minimum timeout.
+     * @param ceiling  Maximum timeout. It is also used until the first answer is received.
+     */
+    void setAdaptiveReadTimeout(Microseconds floor, Microseconds ceiling);
+
+    /** Get the value of the timeout currently used when the queue is waiting for an answer. */
     Microseconds getReadTimeout();
 
+    /** Statistics of the round trip time measured on this interface. */
+    RttStatistics getRttStatistics() const;
+
     /** Get the last CanMessage successfully sent over the CAN network. */
     CanMessage const& getLastMsgSent();
 
+    /** Time at which getLastMsgSent() was given to the CAN driver. */
+    TimePoint getLastMsgSentTime();
+
     /** Get the last CanMessage received from the CAN network. */
     CanMessage const& getLastMsgReceived();
 
@@ -101,8 +163,20 @@ public:
 
     /** Add a callback to be executed when a message is received.
      * It is used _most of the time_ by derived classes to interpret the specific meaning of the message.
+     *
+     * @param non_blocking  Set it to true if the callback is fast and never blocks (no SDO, no waitQueueEmpty).
+     *                      Such callbacks can be executed directly by the receive thread of the CANPort,
+     *                      see enableInlineInterpreters.
      */
-    void addReadInterpreter(InterpreterCallback callback);
+    void addReadInterpreter(InterpreterCallback callback, bool non_blocking = false);
+
+    /**
+     * @brief When enabled, the interpreters added as non_blocking are executed synchronously by the
+     * receive thread of the CANPort, instead of being delegated to the executor of the port.
+     * It saves a thread hop for each message (for example, PDOs are processed with lower latency).
+     * Messages recognized this way don't update getLastMsgReceived. Disabled by default.
+     */
+    void enableInlineInterpreters(bool enable);
 
     /**
      * @brief Block and wait until the queue is empty and no more answer are expected.
@@ -121,6 +195,12 @@ public:
     CANPortPtr can_port();
 
 
+protected:
+
+    /** Called by the executor of the CAN port when the answer to a message that needed one
+     * (see CanMessage::wait_answer) wasn't received in time. The queue then moves on. */
+    virtual void answerTimeout(const CanMessage & /*request*/) {}
+
 private:
 
     class Impl;
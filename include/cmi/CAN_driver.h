@@ -48,6 +48,10 @@ using CanMoveIt::CanMessage;
 extern "C" {
 #endif
 
+/* canReceive_driver and canReceiveBatch_driver may set CanMessage::timestamp_usec to the RX time,
+ * in microseconds since the Unix epoch (CLOCK_REALTIME, std::chrono::system_clock). CANPort converts it
+ * to the clock of CanMoveIt::GetTimeNow(). Leave it to 0 if it isn't available. */
+
 
 int             DLL_CALL( canReceive_driver) (CAN_Handle_t handle, CanMessage * m)			;
 int             DLL_CALL( canSend_driver)    (CAN_Handle_t handle, CanMessage const * m)	;
@@ -56,6 +60,21 @@ CAN_Handle_t    DLL_CALL( canOpen_driver)    (const char *busname, const char* b
 int				DLL_CALL(canClose_driver)   (CAN_Handle_t handle);
 int             DLL_CALL( canStatus_driver ) (CAN_Handle_t handle );
 
+/* Optional symbols. CANPort uses them only if the driver exports them. */
+
+/* Receive up to max_num messages with a single call.
+ * Returns the number of messages stored in buffer, 0 if the timeout expired or a negative error code. */
+int             DLL_CALL( canReceiveBatch_driver ) (CAN_Handle_t handle, CanMessage * buffer, int max_num );
+
+/* Send num messages with a single call.
+ * Returns the number of messages that were sent (possibly less than num) or a negative error code. */
+int             DLL_CALL( canSendBatch_driver ) (CAN_Handle_t handle, CanMessage const * msgs, int num );
+
+/* Ask the driver (or the hardware) to drop all the frames that don't pass at least one of the tests:
+ *       ( cob_id & masks[i] ) == frame_ids[i]
+ * Using num = 0 drops all the frames. Returns 0 on success. */
+int             DLL_CALL( canSetFilters_driver ) (CAN_Handle_t handle, uint16_t const * masks, uint16_t const * frame_ids, int num );
+
 #ifdef __cplusplus
 }
 #endif
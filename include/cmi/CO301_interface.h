@@ -23,6 +23,7 @@
 #include "cmi/log.h"
 #include <stdlib.h>
 #include <map>
+#include <future>
 #include "CAN_Interface.h"
 #include "CO301_def.h"
 #include "ObjectDictionary.h"
@@ -54,6 +55,29 @@ private:
     uint8_t    _size;
 };
 
+/**
+ * @ingroup CANopen
+ * @brief Result of an asynchronous SDO transaction (see CO301_Interface::sdoReadAsync and CO301_Interface::sdoWriteAsync).
+ */
+struct SdoResult
+{
+    ObjectKey    key;
+    /**  - DS_NEW_DATA if the transaction succeeded.
+     *   - DS_TIMEOUT if the answer wasn't received.
+     *   - DS_NO_DATA if the slave aborted the transfer (see abort_code). */
+    DataStatus   status;
+    uint32_t     abort_code;  ///< SDO abort code sent by the slave (0 if none).
+    Variant      value;       ///< Value read from or written to the slave.
+    Microseconds rtt;         ///< Time between the transmission of the request and the reception of the answer.
+
+    SdoResult(): status(DS_NO_DATA), abort_code(0), rtt(0) {}
+};
+
+/** @ingroup CANopen
+ *  @brief Completion callback of an asynchronous SDO transaction. It is executed by the executor of the CAN port:
+ *  it must not block. */
+typedef std::function<void(const SdoResult&)> SdoCallback;
+
 class CO301_Interface;
 
 /** Shared pointer to an instance of CO301_Interface. */
@@ -132,6 +156,10 @@ public:
      * In other words, it sends a message to the slave asking to modify the value of an object in the dictionary.
      * If the modification is accepted by the slave, the new value will be updated in the local ObjectDatabase (_asynchronously_).
      *
+     * Objects larger than 4 bytes (UINT64, FLOAT64, STRING and domains) are written with the segmented
+     * protocol: the segments are sent by the transmission queue as soon as the slave confirms the previous one,
+     * therefore this method doesn't block either. For STRING and domain objects, value must be a STRING.
+     *
      * @param key   Use the ObjectKey or the ObjectID to identify the object entry.
      * @param value the new value to be sent to the device.
      */
@@ -141,6 +169,13 @@ public:
         sdoWrite( findObjectKey(id), value);
     }
 
+    /** Typed version of sdoWrite (see ObjectRef): the value is sent as it is, without Variant conversions. */
+    template <uint16_t I, uint8_t S, typename T, uint16_t K>
+    void sdoWrite( ObjectRef<I,S,T,K> ref, T value )
+    {
+        sdoWriteBytes( _database->keyOf(ref), reinterpret_cast<const uint8_t*>(&value), sizeof(T) );
+    }
+
     /** This function will send a SDO download request (as it is known in CANopen).
      * It sends a message to the slave asking for the value of an object in the dictionary.
      * Once the reply is received (_asynchronously_), the local ObjectDatabase is updated and the associate
@@ -182,6 +217,14 @@ public:
         return getLastObjectReceived( findObjectKey(id), value );
     }
 
+    /** Typed version of getLastObjectReceived (see ObjectRef). Key and type are resolved at compile time:
+     *  the value is copied directly from the ObjectDatabase, without Variant conversions. */
+    template <uint16_t I, uint8_t S, typename T, uint16_t K>
+    DataStatus getLastObjectReceived( ObjectRef<I,S,T,K> ref, T* value )
+    {
+        return _database->readSlot( _database->keyOf(ref), value, true );
+    }
+
 
     /** This function send a SDO download request and wait for the reply.
      * It is similar to sdoReadRemoteObject, but it is blocking.
@@ -209,6 +252,65 @@ public:
         return sdoRequestAndGet( findObjectKey(id), value, wait_answer_timeout);
     }
 
+    /** Time to wait for the answer of a SDO request, derived from the read timeout of the queue
+     * (the request might be queued behind another one that is waiting for its answer). */
+    Microseconds sdoAnswerTimeout() { return getReadTimeout() * 2; }
+
+    /** Non-blocking version of sdoRequestAndGet. The callback is invoked when the answer is received,
+     * when the slave aborts the transfer or when the read timeout of the queue expires.
+     * Many transactions (on the same node or on different ones) can be in flight at the same time;
+     * the transactions of a single node are executed in order.
+     */
+    void sdoReadAsync( ObjectKey const& key, SdoCallback callback );
+
+    /** Same as sdoReadAsync( ObjectKey const&, SdoCallback ), but the result is delivered through a future. */
+    std::future<SdoResult> sdoReadAsync( ObjectKey const& key );
+
+    /** Non-blocking version of sdoWrite that notifies when the slave confirmed (or refused) the new value. */
+    void sdoWriteAsync( ObjectKey const& key, Variant const& value, SdoCallback callback );
+
+    /** Same as sdoWriteAsync( ObjectKey const&, Variant const&, SdoCallback ), but the result is delivered through a future. */
+    std::future<SdoResult> sdoWriteAsync( ObjectKey const& key, Variant const& value );
+
+    /** Read many objects with a single wait: all the requests are queued at once, so the queue is never idle
+     * waiting for the caller.
+     *
+     * @param keys     Objects to read.
+     * @param results  One result for each key, in the same order.
+     * @param timeout  Maximum time to wait for all the answers. The objects that are not completed get DS_TIMEOUT.
+     * @return         The number of objects read successfully.
+     */
+    int sdoReadMany( std::vector<ObjectKey> const& keys, std::vector<SdoResult>* results, Microseconds timeout );
+
+    /** Write many objects with a single wait. See sdoReadMany. */
+    int sdoWriteMany( std::vector< std::pair<ObjectKey, Variant> > const& values, std::vector<SdoResult>* results, Microseconds timeout );
+
+    /** SDO block upload (CiA 301): the slave sends the object in blocks of up to getSdoBlockSize() segments,
+     * each one acknowledged only once. Use it for large objects (domains, strings, recorders).
+     * The value is stored in the ObjectDatabase and passed to the callback as a raw buffer (type STRING).
+     * Only one block transfer per node can be active at a time (an exception is thrown otherwise).
+     *
+     * @param key       Object to read.
+     * @param callback  Invoked when the transfer is completed, aborted or timed out.
+     * @param use_crc   Ask the slave to protect the data with a CRC (used only if the slave supports it).
+     */
+    void sdoBlockUploadAsync( ObjectKey const& key, SdoCallback callback, bool use_crc = true );
+
+    /** SDO block download (CiA 301). See sdoBlockUploadAsync.
+     *
+     * @param key       Object to write.
+     * @param data      Raw bytes to write.
+     * @param length    Number of bytes.
+     * @param callback  Invoked when the transfer is completed, aborted or timed out.
+     * @param use_crc   Protect the data with a CRC (used only if the slave supports it).
+     */
+    void sdoBlockDownloadAsync( ObjectKey const& key, const uint8_t* data, size_t length, SdoCallback callback, bool use_crc = true );
+
+    /** Number of segments per block requested to the slave during block uploads (1 to 127, default 127).
+     * During block downloads, the size is decided by the slave. */
+    void setSdoBlockSize( uint8_t segments );
+    uint8_t getSdoBlockSize() const;
+
     /** Use this method to do the entire PDO mapping process.
      * Note that the device must be in state NMT_PRE_OPERATIONAL.
      *
@@ -296,18 +398,47 @@ public:
 
     ObjectID getObjectID(ObjectKey key );
 
+    /** Same as findObjectKey, but it returns ObjectKey(ObjectsDictionary::NOT_FOUND) instead of throwing. */
     ObjectKey tryFindObjectKey( ObjectID id) ;
 
 private:
 
+    virtual void answerTimeout(const CanMessage & request);
+
+    struct SdoBatch;
+    int waitSdoBatch( std::shared_ptr<SdoBatch> batch, std::vector<SdoResult>* results, Microseconds timeout );
+
+    enum SdoAnswerType{ SDO_UPLOAD_DONE, SDO_DOWNLOAD_DONE, SDO_ABORTED, SDO_EXPIRED };
+    void completeSdo(bool tagged, ObjectKey const& key, SdoAnswerType answer, uint32_t abort_code, TimePoint answer_time);
+
+    // tagged: the requests are sent with CanMessage::tag set (see sdoReadAsync / sdoWriteAsync).
+    void sdoObjectRequest(ObjectKey const& key, bool tagged);
+    void sdoWrite(ObjectKey const& key, Variant const& value, bool tagged);
+    void sdoWriteBytes(ObjectKey const& key, const uint8_t* bytes, uint8_t size, bool tagged = false);
+    void sdoWriteSegmented(ObjectKey const& key, std::vector<uint8_t>&& data, bool tagged);
+    bool SDO_SegmentedInterpreter(const CanMessage & m);
+    void pushSegmentRequest();
+    bool cancelSegmentedTransfer(ObjectKey const& key);
+    void abortSegmentedTransfer(ObjectKey const& key, uint32_t abort_code);
+
+    void pushSdoRequest(const CanMessage& msg);
+    void releaseSdoRequests();
+    bool SDO_BlockInterpreter(const CanMessage & m);
+    void sendBlockDownloadSegments();
+    void finishBlockTransfer(DataStatus status, uint32_t abort_code, TimePoint answer_time);
+    void abortBlockTransfer(uint32_t abort_code);
+    int  receivedNewBuffer(ObjectKey const& key, const uint8_t * data, size_t length, TimePoint timestamp);
+
     bool SDO_Interpreter(const CanMessage & m);
     bool PDO_Interpreter(const CanMessage & m);
+    void compilePdoDecoder();
+    void notifyObjectsUpdated(uint16_t cob_id, const ObjectKey* keys, uint8_t count, TimePoint timestamp);
     int  receivedNewObject(ObjectKey const& key, const uint8_t * data, TimePoint timestamp);
     void initPDO(PDO_Id pdo);
 
     class Impl;
     Impl* _d;
-
+    ObjectsDatabase* _database; // the one of Impl, used by the typed accessors.
 };
 
 
@@ -87,6 +87,10 @@ public:
 
             uint32_t received          : 1;
             uint32_t sent              : 1;
+
+            /// @brief Not sent on the bus. Free for the classes derived from CanInterface:
+            /// it is preserved in getLastMsgSent() and in the argument of answerTimeout().
+            uint32_t tag               : 1;
         };
     };
 
@@ -95,7 +99,9 @@ public:
 
     /// @brief Placeholder for a timestamp.
     /// This can't be a CanMoveIt::TimePoint for technical reasons, therefore we use time_since_epoch
-    /// instead and we store is microseconds
+    /// instead and we store is microseconds.
+    /// On received messages, it is the RX timestamp of the driver (if supported) or the time
+    /// when the message was read by CANPort.
     uint64_t timestamp_usec;
 
     CanMessage();
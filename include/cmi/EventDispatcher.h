@@ -60,6 +60,18 @@ typedef uint32_t EventID;
  **/
 const EventID  EVENT_ERROR_IN_PROTOCOL(1);    /// SDO Command not recognized. EventData::data will contain the error code.
 const EventID  EVENT_EMERGENCY_FAULT(2);      /// Emergency message received. EventData::data will contain the error code.
+const EventID  EVENT_PDO_RECEIVED(3);         /// PDO received. EventData::data will contain EventDataPdoReceived.
+
+/** @ingroup CANopen
+ * This is the type "hidden" inside EventData::info by EVENT_PDO_RECEIVED: a single notification
+ * for all the objects updated by a PDO (use CO301_Interface::getLastObjectReceived to read them).
+ */
+class EventDataPdoReceived{
+public:
+    uint16_t   cob_id;
+    uint8_t    num_keys;
+    ObjectKey  keys[8];
+};
 
 
 ///** @ingroup CANopen
@@ -160,6 +172,12 @@ public:
      */
     void push_event(uint16_t device_id,const EventData & data);
 
+    /**
+     * @brief Cheap (lock-free) test that can be used to avoid building an EventData that nobody
+     * would receive. It might return true even if there isn't any subscriber, never the opposite.
+     */
+    bool hasSubscribers(EventID const& id) const;
+
     /**
      * @brief This method MUST be used together with CALLBACK_ASYNCH.
      * In fact, it will flush _all_ the callbacks that where stored into the queue of
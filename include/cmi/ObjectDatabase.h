@@ -20,6 +20,8 @@
 #define OBJECT_DATABASE_H
 
 #include "cmi/ObjectDictionary.h"
+#include <atomic>
+#include <thread>
 
 namespace CanMoveIt {
 
@@ -107,7 +109,9 @@ public:
     ObjectsDatabase(ObjectsDictionaryPtr dictionary);
     ~ObjectsDatabase();
 
-    /** Since value is stored as Variant, you need to cast to the right type. */
+    /** Since value is stored as Variant, you need to cast to the right type.
+     *  Numeric entries are read without locks (seqlock), so that real-time threads never wait for
+     *  the thread that receives the PDOs. */
     DataStatus getValue( ObjectKey const& key, Variant* value );
 
     /**  Change the value of an entry in the ObjectsDatabase.*/
@@ -116,15 +120,103 @@ public:
     /**  Change the value of an entry in the ObjectsDatabase using an array of raw bytes (little indian notation).*/
     uint8_t setValueFromBytes(ObjectKey const& key, const uint8_t *data_bytes, TimePoint timestamp = GetTimeNow());
 
+    /**  Same as setValueFromBytes, for count entries at once (all the objects of a PDO).
+     *   Numeric entries only; it doesn't allocate memory.*/
+    void setValuesFromBytes(const ObjectKey* keys, const uint8_t* const* data_bytes, size_t count, TimePoint timestamp);
+
+    /**  Change the value of an entry using a buffer of arbitrary length (segmented and block SDO transfers).
+     *   STRING and domain entries take the entire buffer, numeric ones the first size() bytes.*/
+    void setValueFromBuffer(ObjectKey const& key, const uint8_t *data_bytes, size_t length, TimePoint timestamp = GetTimeNow());
+
     /**  Read the value of an entry in the ObjectsDatabase.*/
     ObjectData& getData(ObjectKey const& key);
 
     void rebuild(ObjectsDictionaryPtr dictionary = ObjectsDictionaryPtr());
 
+    /** Typed version of getValue (see ObjectRef). Key and type are known at compile time, therefore the value is
+     *  copied directly from its slot, without any Variant conversion. */
+    template <uint16_t I, uint8_t S, typename T, uint16_t K>
+    DataStatus getValue( ObjectRef<I,S,T,K> ref, T* value ) const
+    {
+        return readSlot( keyOf(ref), value );
+    }
+
+    /** Typed version of setValue (see ObjectRef). */
+    template <uint16_t I, uint8_t S, typename T, uint16_t K>
+    void setValue( ObjectRef<I,S,T,K> ref, T value, TimePoint timestamp = GetTimeNow() )
+    {
+        setValueFromBytes( keyOf(ref), reinterpret_cast<const uint8_t*>(&value), timestamp );
+    }
+
+    /** Key of the entry described by ref. It is the key stored in ref if the dictionary is the one ref was generated from,
+     *  otherwise it is searched at runtime. Throws TypeException if the type of the entry isn't T. */
+    template <uint16_t I, uint8_t S, typename T, uint16_t K>
+    ObjectKey keyOf( ObjectRef<I,S,T,K> ) const
+    {
+        typedef ObjectRef<I,S,T,K> Ref;
+        if( Ref::key < _num_slots &&
+            _entries[Ref::key].id() == Ref::id() &&
+            _entries[Ref::key].type() == Ref::type() )
+        {
+            return ObjectKey( Ref::key );
+        }
+        return resolveKey( Ref::id(), Ref::type() );
+    }
+
 private:
 
+    friend class CO301_Interface;
+
+    ObjectKey resolveKey(ObjectID id, TypeID type) const;
+
+    // Even value of the sequence counter of an entry: a writer holds it odd only for a few nanoseconds,
+    // so the reader spins a little before giving up its time slice, as beginWrite does.
+    static uint32_t readSequence( const std::atomic<uint32_t>& seq )
+    {
+        uint32_t s = seq.load( std::memory_order_acquire );
+        for( int spins = 0; s & 1; spins++ )
+        {
+            if( spins >= 64 )
+            {
+                std::this_thread::yield();
+            }
+            s = seq.load( std::memory_order_acquire );
+        }
+        return s;
+    }
+
+    // Same as getValue, for a numeric entry of type T. Readers never block (see the seqlock in ObjectDatabase.cpp).
+    template <typename T> DataStatus readSlot( ObjectKey key, T* value, bool mark_as_read = false ) const
+    {
+        const ObjectData& obj = _slots[key];
+        const std::atomic<uint32_t>& seq = _sequence[key];
+        while( true )
+        {
+            const uint32_t before = readSequence( seq );
+            const DataStatus status = obj.get_isnew();
+            const T snapshot = obj.get().extract<T>();
+
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if( seq.load( std::memory_order_relaxed ) == before )
+            {
+                *value = snapshot;
+                if( mark_as_read && status != DS_NO_DATA )
+                {
+                    _slots[key].set_isnew( DS_OLD_DATA );
+                }
+                return status;
+            }
+        }
+    }
+
     class Impl;
     Impl* _d;
+
+    // Direct access to the storage of Impl for the typed accessors; updated by rebuild().
+    ObjectData*                  _slots;
+    const std::atomic<uint32_t>* _sequence;
+    const ObjectEntry*           _entries;
+    uint16_t                     _num_slots;
 };
 
 /**
@@ -24,6 +24,7 @@
 #include <sstream>
 #include <map>
 #include <typeinfo>
+#include <type_traits>
 #include <boost/serialization/strong_typedef.hpp>
 #include "builtin_types.hpp"
 #include "variant.hpp"
@@ -77,6 +78,9 @@ private:
  * @ingroup can_open
  * @class ObjectEntry
  * @brief This is the container of a single entry inside a certain ObjectsDictionary.
+ *
+ * It is a small value type (no heap allocation): id, type, access and mapping flags are stored inline,
+ * while the name and the default value are owned by the ObjectsDictionary that contains the entry.
  * */
 class ObjectEntry
 {
@@ -94,30 +98,67 @@ public:
     }AccessType;
 
     ObjectEntry();
+
+    /** description isn't copied: it must outlive the entry. ObjectsDictionary makes its own copy when the
+     *  entry is inserted. */
     ObjectEntry(uint16_t index, uint8_t subindex,
                 AccessType access, bool mappable,
                 TypeID type,
-                const char* description = NULL,
-                Variant default_val = Variant());
-
-    TypeID      type()            const;
-    uint8_t     size()            const;
-    ObjectID    id()              const;
-    uint16_t    index()           const;
-    uint8_t     subindex()        const;
-    bool        PDO_is_mapable()  const;
-    AccessType  access_type()     const;
-    bool        empty()           const;
-    const char* name()            const;
+                const char* description = NULL);
+
+    TypeID      type()            const { return static_cast<TypeID>( _raw_type ); }
+    uint8_t     size()            const { return getSize( type() ); }
+    ObjectID    id()              const { return _id; }
+    uint16_t    index()           const { return _id.index(); }
+    uint8_t     subindex()        const { return _id.subindex(); }
+    bool        PDO_is_mapable()  const { return _PDO_mapable; }
+    AccessType  access_type()     const { return static_cast<AccessType>( _access_type ); }
+    bool        empty()           const { return ( type() == OTHER || _id == ObjectID(0,0) ); }
+    const char* name()            const { return _name ? _name : ""; }
     void print() const;
     Variant   default_value() const;
 
 private:
-
-    struct Impl;
-    std::shared_ptr< Impl > _d;
+    friend class ObjectsDictionary;
+
+    ObjectID  _id;
+    struct{
+        uint8_t  _access_type    : 2;
+        uint8_t  _PDO_mapable    : 1;
+        uint8_t  _raw_type       : 5;
+    };
+    const char*     _name;
+    const Variant*  _default_value; // owned by the dictionary, NULL if there isn't any.
 };
 
+/**
+ * @ingroup can_open
+ * @brief Compile time descriptor of a numeric object: index, subindex and C++ type of its value.
+ *
+ * Key is the position of the entry in the dictionary the descriptor was created from (see ObjectsDictionary::generateCode).
+ * The typed accessors of ObjectsDatabase and CO301_Interface use it directly when the dictionary of the device is the same,
+ * otherwise they look for the entry at runtime.
+ *
+ * @code
+ *   constexpr ObjectRef<0x6064, 0, int32_t> Position_actual_value{};
+ *   int32_t position;
+ *   device->getLastObjectReceived( Position_actual_value, &position );
+ * @endcode
+ */
+template <uint16_t Index, uint8_t Subindex, typename T, uint16_t Key = 0xFFFF>
+struct ObjectRef
+{
+    static_assert( std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                   "ObjectRef can describe only numeric objects" );
+    typedef T value_type;
+
+    static constexpr uint16_t index    = Index;
+    static constexpr uint8_t  subindex = Subindex;
+    static constexpr uint16_t key      = Key;
+
+    static ObjectID id()    { return ObjectID( Index, Subindex ); }
+    static TypeID   type()  { return getType<T>(); }
+};
 
 /**
  * @ingroup can_open
@@ -138,11 +179,29 @@ public:
     enum{ NOT_FOUND = 0xFFFF };
 
     const ObjectEntry& getEntry(ObjectKey const& key);
+
+    /** Key of the entry with the given index/subindex. Throws if it isn't in the dictionary. */
     ObjectKey find(uint16_t index, uint8_t subindex);
 
+    /** Same as find, but it returns ObjectKey(NOT_FOUND) instead of throwing.
+     *  Doesn't allocate memory: it can be used on the hot path. */
+    ObjectKey tryFind(uint16_t index, uint8_t subindex) const;
+
+    /** Write [name].h and [name].cpp, the source code of a class that contains this dictionary, without parsing the EDS.
+     *  The header also contains a constexpr ObjectRef for each numeric entry, in the namespace [name]_Objects. */
     void generateCode(const char* name);
     void parseEDS(std::ifstream &fin);
 
+    /** Parse the EDS file directly from a memory mapping of the file (faster than the ifstream).
+     *
+     *  If cache_directory isn't NULL, the dictionary is loaded from the binary cache [cache_directory]/[name of the EDS].cache
+     *  when it was created from the same content of the EDS file and by the same version of the library. Otherwise the EDS
+     *  is parsed and the cache is (re)written; if the directory isn't writable, the cache is just skipped. */
+    void parseEDS(const char* filename, const char* cache_directory = NULL);
+
+    /** Parse the text of an EDS that is already in memory. */
+    void parseEDS(const char* text, size_t length);
+
     uint16_t size() const;
     ObjectEntry& at( uint16_t position);
     void clear();
@@ -154,12 +213,19 @@ public:
     uint32_t revisionNumber() const;
 
 protected:
-    /** Insert a new object into the dictionary. This is done only during allocation of derived classes (lazy initialization). */
-    void insert(ObjectEntry const&  obj);
+    /** Insert a new object into the dictionary. This is done only during allocation of derived classes (lazy initialization).
+     *  Name and default_value are copied into the storage of the dictionary. */
+    void insert(ObjectEntry const&  obj, Variant const& default_value = Variant() );
+
+    /** Preallocate the storage of the entries (used by the code created with generateCode). */
+    void reserve(uint16_t num_entries);
 
 private:
     struct Impl;
     Impl* _d;
+
+    bool saveCache(const char* filename, uint64_t eds_hash, uint64_t eds_size) const;
+    bool loadCache(const char* filename, uint64_t eds_hash, uint64_t eds_size);
 };
 
 /// Shared pointer of a ObjectsDictionary class.
@@ -178,9 +244,20 @@ typedef std::shared_ptr< ObjectsDictionary > ObjectsDictionaryPtr;
  *                   by GetInstanceObjectDictionary and create_CO301_Interface.
  * @return           The smart pointer of the ObjectDictionary (to be used for example in the constructors of ObjectDatabase and
  *                    CO301_Interface).
+ * @remark If a cache directory was set with setObjectDictionaryCacheDirectory, the first time an EDS file is loaded
+ *         a binary copy of the dictionary is written there; the following loads map it instead of parsing the EDS again,
+ *         as long as the content of the EDS doesn't change.
  **/
 ObjectsDictionaryPtr createObjectDictionary(const char* filename, const char* OD_name);
 
+/**
+ * @ingroup can_open
+ * Enable the binary cache of the dictionaries loaded by createObjectDictionary and reloadObjectDictionary
+ * (see ObjectsDictionary::parseEDS). It is disabled by default: nothing is written next to the EDS files.
+ * @param directory  Where the caches are written. NULL or empty to disable the cache.
+ **/
+void setObjectDictionaryCacheDirectory(const char* directory);
+
 /**
  * @ingroup can_open
  * Access pre-allocated ObjectDictionary. Don't forget that multiple ObjectDatabase instances can (and should)
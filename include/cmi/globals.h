@@ -61,6 +61,8 @@ public:
 
     std::vector< CANPortPtr >                   opened_can_ports;
     std::map<std::string, ObjectsDictionaryPtr> object_dictionaries;
+    // empty: the dictionaries aren't cached (see setObjectDictionaryCacheDirectory).
+    std::string                                 dictionary_cache_directory;
 
     ~CMI();
 };
@@ -35,6 +35,7 @@
 #ifndef VARIANT_H
 #define VARIANT_H
 
+#include <array>
 #include <type_traits>
 #include <limits>
 #include <string>
@@ -10,17 +10,206 @@
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/high_resolution_timer.hpp>
+#include <atomic>
+#include <deque>
 #include "OS/AsyncManager.h"
 
 namespace CanMoveIt {
 
 typedef std::shared_ptr< boost::asio::deadline_timer > DeadLinePtr;
 
+// Bounded multi-producer / single-consumer queue (D. Vyukov). Each cell has a sequence
+// number that tells if it is ready to be written (seq == pos) or read (seq == pos+1).
+class TaskRing
+{
+public:
+    typedef AsyncManager::Task_t Task_t;
+
+    enum{ CAPACITY = 1024 };  // must be a power of 2
+
+    TaskRing(): enqueue_pos(0), dequeue_pos(0)
+    {
+        for( size_t i = 0; i < CAPACITY; i++ )
+        {
+            cells[i].sequence.store( i, std::memory_order_relaxed );
+        }
+    }
+
+    // Thread safe. Returns false if the ring is full.
+    bool push(Task_t& task)
+    {
+        size_t pos = enqueue_pos.load( std::memory_order_relaxed );
+        Cell* cell;
+        while( true )
+        {
+            cell = &cells[ pos & (CAPACITY-1) ];
+            size_t seq = cell->sequence.load( std::memory_order_acquire );
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if( diff == 0 )
+            {
+                if( enqueue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) break;
+            }
+            else if( diff < 0 ) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos.load( std::memory_order_relaxed );
+            }
+        }
+        cell->task = std::move( task );
+        cell->sequence.store( pos + 1, std::memory_order_release );
+        return true;
+    }
+
+    // To be called by the consumer only.
+    bool pop(Task_t& task)
+    {
+        size_t pos = dequeue_pos;
+        Cell* cell = &cells[ pos & (CAPACITY-1) ];
+        size_t seq = cell->sequence.load( std::memory_order_acquire );
+        if( (intptr_t)seq - (intptr_t)(pos + 1) < 0 )
+        {
+            return false;
+        }
+        task = std::move( cell->task );
+        cell->task = Task_t();
+        cell->sequence.store( pos + CAPACITY, std::memory_order_release );
+        dequeue_pos = pos + 1;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Task_t              task;
+    };
+    Cell                cells[CAPACITY];
+    std::atomic<size_t> enqueue_pos;
+    size_t              dequeue_pos;
+};
+
+// Tasks added with addImmediateTask. They are executed by DrainHandler. At most one
+// DrainHandler is queued in the io_service at any time.
+class ImmediateTaskQueue
+{
+public:
+    typedef AsyncManager::Task_t Task_t;
+
+    ImmediateTaskQueue(): drain_pending(false), overflow_used(false)
+    {
+        handler_memory_used[0] = false;
+        handler_memory_used[1] = false;
+    }
+
+    // Returns true if a DrainHandler must be posted.
+    bool push(Task_t& task)
+    {
+        if( overflow_used.load() || !ring.push( task ) )
+        {
+            LockGuard lock( overflow_mutex );
+            overflow_tasks.push_back( std::move(task) );
+            overflow_used = true;
+        }
+        return !drain_pending.exchange( true );
+    }
+
+    // The io_service was stopped: the DrainHandler already posted (if any) will never be executed,
+    // therefore the next push must post a new one.
+    void cancelDrain()
+    {
+        drain_pending = false;
+    }
+
+    void drain()
+    {
+        // acquire the tasks published before drain_pending was set.
+        drain_pending.exchange( false );
+
+        Task_t task;
+        while( ring.pop( task ) )
+        {
+            task();
+        }
+        if( overflow_used.load() )
+        {
+            std::deque<Task_t> tasks;
+            {
+                LockGuard lock( overflow_mutex );
+                tasks.swap( overflow_tasks );
+                overflow_used = false;
+            }
+            for( Task_t& overflow_task: tasks ) { overflow_task(); }
+        }
+    }
+
+    void* allocateHandler(std::size_t size)
+    {
+        if( size <= HANDLER_MEMORY_SIZE )
+        {
+            for( int i = 0; i < 2; i++ )
+            {
+                if( !handler_memory_used[i].exchange( true ) ) return &handler_memory[i];
+            }
+        }
+        return ::operator new( size );
+    }
+
+    void deallocateHandler(void* pointer)
+    {
+        for( int i = 0; i < 2; i++ )
+        {
+            if( pointer == &handler_memory[i] )
+            {
+                handler_memory_used[i] = false;
+                return;
+            }
+        }
+        ::operator delete( pointer );
+    }
+
+private:
+    TaskRing             ring;
+    std::atomic<bool>    drain_pending;
+
+    // Used only when the ring is full. While it isn't empty, new tasks are appended here
+    // too, to preserve the order.
+    Mutex                overflow_mutex;
+    std::deque<Task_t>   overflow_tasks;
+    std::atomic<bool>    overflow_used;
+
+    // Memory of the DrainHandler. Two slots, because a new handler might be posted
+    // while the previous one is still being released.
+    enum{ HANDLER_MEMORY_SIZE = 256 };
+    std::aligned_storage<HANDLER_MEMORY_SIZE>::type handler_memory[2];
+    std::atomic<bool>    handler_memory_used[2];
+};
+
+struct DrainHandler
+{
+    ImmediateTaskQueue* queue;
+    void operator()() { queue->drain(); }
+};
+
+// asio allocation hooks: the memory of DrainHandler is recycled.
+inline void* asio_handler_allocate(std::size_t size, DrainHandler* handler)
+{
+    return handler->queue->allocateHandler( size );
+}
+
+inline void asio_handler_deallocate(void* pointer, std::size_t /*size*/, DrainHandler* handler)
+{
+    handler->queue->deallocateHandler( pointer );
+}
+
 class  AsyncManager::Impl{
 
 public:
+    // Declared before io_service: the DrainHandlers still queued when io_service is destroyed
+    // release their memory into immediate_tasks.
+    ImmediateTaskQueue                 immediate_tasks;
     boost::asio::io_service			   io_service;
-    boost::asio::strand			       strand;
+    boost::asio::io_service::strand    strand;
     boost::asio::deadline_timer        dummy_timer;
     std::shared_ptr<boost::thread>     timer_thread;
 
@@ -82,6 +271,8 @@ void AsyncManager::kill()
 
     if( _d->timer_thread)
             _d->timer_thread->join();
+
+    _d->immediate_tasks.cancelDrain();
 }
 
 void AsyncManager::delAlarm(Handle_t alarm)
@@ -114,6 +305,15 @@ void AsyncManager::addImmediateCallback(Callback_t callback)
                                                     callback) ) );
 }
 
+void AsyncManager::addImmediateTask(Task_t task)
+{
+    if( _d->immediate_tasks.push( task ) )
+    {
+        DrainHandler handler = { &_d->immediate_tasks };
+        _d->strand.post( handler );
+    }
+}
+
 void AsyncManager::flush_expired()
 {
     _d->io_service.poll();
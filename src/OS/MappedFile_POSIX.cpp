@@ -0,0 +1,53 @@
+#include "OS/MappedFile.h"
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace CanMoveIt {
+
+MappedFile::MappedFile(const char* filename):
+    _data( nullptr ),
+    _size( 0 )
+{
+    const int fd = ::open( filename, O_RDONLY );
+    if( fd < 0 )
+    {
+        throw std::runtime_error( std::string("MappedFile: can't open ") + filename );
+    }
+
+    struct stat info;
+    if( ::fstat( fd, &info ) != 0 )
+    {
+        ::close( fd );
+        throw std::runtime_error( std::string("MappedFile: can't read the size of ") + filename );
+    }
+
+    // mmap doesn't accept a length of zero: an empty file is just an empty buffer.
+    if( info.st_size > 0 )
+    {
+        void* ptr = ::mmap( nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( ptr == MAP_FAILED )
+        {
+            ::close( fd );
+            throw std::runtime_error( std::string("MappedFile: can't map ") + filename );
+        }
+        ::madvise( ptr, info.st_size, MADV_SEQUENTIAL );
+        _data = static_cast<const char*>( ptr );
+        _size = static_cast<size_t>( info.st_size );
+    }
+    // the mapping stays valid after the file descriptor is closed.
+    ::close( fd );
+}
+
+MappedFile::~MappedFile()
+{
+    if( _data )
+    {
+        ::munmap( const_cast<char*>(_data), _size );
+    }
+}
+
+} // namespace CanMoveIt
@@ -0,0 +1,51 @@
+#include "OS/MappedFile.h"
+#include <stdexcept>
+#include <string>
+#include <windows.h>
+
+namespace CanMoveIt {
+
+MappedFile::MappedFile(const char* filename):
+    _data( nullptr ),
+    _size( 0 ),
+    _file( INVALID_HANDLE_VALUE ),
+    _mapping( nullptr )
+{
+    _file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if( _file == INVALID_HANDLE_VALUE )
+    {
+        throw std::runtime_error( std::string("MappedFile: can't open ") + filename );
+    }
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( _file, &size ) )
+    {
+        CloseHandle( _file );
+        throw std::runtime_error( std::string("MappedFile: can't read the size of ") + filename );
+    }
+
+    // a mapping of length zero isn't allowed: an empty file is just an empty buffer.
+    if( size.QuadPart > 0 )
+    {
+        _mapping = CreateFileMappingA( _file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        const void* ptr = _mapping ? MapViewOfFile( _mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+        if( !ptr )
+        {
+            if( _mapping ) CloseHandle( _mapping );
+            CloseHandle( _file );
+            throw std::runtime_error( std::string("MappedFile: can't map ") + filename );
+        }
+        _data = static_cast<const char*>( ptr );
+        _size = static_cast<size_t>( size.QuadPart );
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if( _data )     UnmapViewOfFile( _data );
+    if( _mapping )  CloseHandle( _mapping );
+    CloseHandle( _file );
+}
+
+} // namespace CanMoveIt
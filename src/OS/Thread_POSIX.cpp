@@ -46,6 +46,18 @@ void Thread::setCurrentPriority(int prio,int  policy )
     }
 }
 
+void Thread::setCurrentAffinity(int cpu)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO( &cpuset );
+    CPU_SET( cpu, &cpuset );
+    int ret = pthread_setaffinity_np( pthread_self(), sizeof(cpu_set_t), &cpuset );
+    if (ret)
+    {
+        Log::SYS()->error("Warning: Cannot change the thread affinity. Code {}", ret);
+    }
+}
+
 
 void Thread::setPriority(int prio,int  policy )
 {
@@ -41,6 +41,12 @@ void Thread::setCurrentPriority(int prio,int /* policy */)
                 throw std::runtime_error("cannot set thread priority");
 }
 
+void Thread::setCurrentAffinity(int cpu)
+{
+    if (SetThreadAffinityMask( GetCurrentThread(), DWORD_PTR(1) << cpu ) == 0)
+                throw std::runtime_error("cannot set thread affinity");
+}
+
 
 void Thread::setPriority(int prio,int /* policy */)
 {
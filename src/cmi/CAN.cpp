@@ -21,6 +21,7 @@
 #include <cassert>
 #include <stdlib.h>
 #include <deque>
+#include <atomic>
 #include <boost/circular_buffer.hpp>
 #include "absl/types/any.h"
 
@@ -29,6 +30,13 @@
 #include "cmi/globals.h"
 #include "cmi/CAN_driver.h"
 #include "OS/SharedLibrary.h"
+#include "OS/AsyncManager.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 namespace CanMoveIt
 {
@@ -41,14 +49,21 @@ std::function<CAN_Handle_t( const char*, const char* )> canOpen_driver;
 std::function<int ( CAN_Handle_t )> canClose_driver;
 std::function<int ( CAN_Handle_t, char* )> canChangeBitRate_driver;
 std::function<int ( CAN_Handle_t )> canStatus_driver;
+std::function<int ( CAN_Handle_t, CanMessage*, int )> canReceiveBatch_driver;
+std::function<int ( CAN_Handle_t, CanMessage const*, int )> canSendBatch_driver;
+std::function<int ( CAN_Handle_t, uint16_t const*, uint16_t const*, int )> canSetFilters_driver;
 
 
 class CANPort::Impl{
 public:
     int16_t receive(CanMessage *m);
+    int  receiveAndDispatch();
     void receiveLoop();
-    void dispatchMessage(const CanMessage& m );
-    void tracePush(const CanMessage& m);
+    void dispatchMessages(const CanMessage* m, int num_msgs );
+    void tracePush(const CanMessage* m, int num_msgs = 1);
+    void publishDispatchTable();
+    void updateDriverFilter();
+    void waitReadersQuiescent(uint64_t epoch);
 
     CAN_Handle_t   handle;
     std::string    busname;
@@ -67,18 +82,264 @@ public:
         CanRcvCallback callback;
     } SubscriptionInfo;
 
-    std::map<int, SubscriptionInfo> subscribers;
-    ThreadPtr                       receive_task;  /**< CAN Receiver task*/
+    typedef std::shared_ptr<const SubscriptionInfo> SubscriptionPtr;
+
+    // number of possible values of CanMessage::cob_id (11 bits).
+    enum{ COB_ID_TABLE_SIZE = 2048 };
+
+    // Immutable snapshot of the subscribers. For each cob_id, it contains the list of the
+    // callbacks whose (mask, frame_id) match it. "owners" keeps the callbacks alive as long
+    // as the snapshot exists.
+    struct DispatchTable
+    {
+        std::vector<SubscriptionPtr>                       owners;
+        std::vector< std::vector<const CanRcvCallback*> >  by_cob_id;
+        DispatchTable(): by_cob_id( COB_ID_TABLE_SIZE ) {}
+    };
+
+    struct RetiredTable
+    {
+        const DispatchTable* table;
+        uint64_t             reader_epoch;
+    };
+
+    // Modified only by the writers, with dispatcher_mutex locked.
+    std::map<int, SubscriptionPtr>   subscribers;
+    std::vector<RetiredTable>        retired_tables;
+    bool                             driver_filter_enabled;
+
+    // max number of frames read at once when the driver provides canReceiveBatch_driver
+    enum{ RECEIVE_BATCH_SIZE = 64 };
+
+    // RCU-like publication of the DispatchTable. The receive thread (the only reader) never locks:
+    //  - it increments reader_epoch before loading dispatch_table and again when it is done with it,
+    //    therefore reader_epoch is odd only while a snapshot is in use.
+    //  - writers build a new table, exchange the pointer and free the old one only once the
+    //    reader went past the epoch that was current when the table was replaced.
+    std::atomic<const DispatchTable*> dispatch_table;
+    std::atomic<uint64_t>             reader_epoch;
+
+    ThreadPtr                       receive_task;  /**< CAN Receiver task (empty in reactor mode)*/
+    std::shared_ptr<AsyncManager>   executor;      /**< Empty if the port uses CMI::async_can*/
+    bool                            use_shared_executor;
+    CanMessage                      receive_buffer[RECEIVE_BATCH_SIZE];
 
     Impl():
         opened(0),
         trace_queue(50),
-        trace_enabled(false)
+        trace_enabled(false),
+        driver_filter_enabled(false),
+        dispatch_table( new DispatchTable ),
+        reader_epoch(0),
+        use_shared_executor(false)
     {
         handle.fd = -1;
         handle.vp = NULL;
     }
+
+    ~Impl()
+    {
+        for( RetiredTable& retired: retired_tables ) { delete retired.table; }
+        delete dispatch_table.load();
+    }
+};
+// CANPort being dispatched by the current thread (used to detect re-entrant calls from the callbacks).
+static thread_local const void* tls_dispatching_port = NULL;
+
+#ifndef WIN32
+//--------------------------------------------------------------
+// Receive reactor: all the ports share a single epoll set, served by a pool of threads.
+// Each fd is registered with EPOLLONESHOT, therefore only one thread at a time reads
+// from a certain port (the dispatcher of CANPort assumes a single reader).
+class CanReceiveReactor
+{
+public:
+    typedef std::function<void(void)> ReadableCallback;
+
+    CanReceiveReactor(int num_threads, int first_cpu);
+    ~CanReceiveReactor();
+
+    void addPort(int fd, ReadableCallback callback);
+    void removePort(int fd);
+    bool isReactorThread(Thread::ID tid) const;
+
+private:
+    void run(int cpu);
+    void rearm(int fd);
+
+    struct Port
+    {
+        ReadableCallback callback;
+        Thread::ID       running_in;   // thread that is executing the callback, if any.
+    };
+    typedef std::shared_ptr<Port> PortPtr;
+
+    int                         epoll_fd;
+    int                         shutdown_fd;
+    std::vector<ThreadPtr>      threads;
+    Mutex                       ports_mutex;
+    Condition                   port_idle;
+    std::map<int, PortPtr>      ports;
 };
+
+std::unique_ptr<CanReceiveReactor> can_receive_reactor;
+
+CanReceiveReactor::CanReceiveReactor(int num_threads, int first_cpu)
+{
+    epoll_fd    = epoll_create1( EPOLL_CLOEXEC );
+    shutdown_fd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+    if( epoll_fd < 0 || shutdown_fd < 0 )
+    {
+        throw std::runtime_error("CanReceiveReactor: can't create epoll/eventfd");
+    }
+
+    // level triggered: once written, it wakes up all the threads.
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = shutdown_fd;
+    epoll_ctl( epoll_fd, EPOLL_CTL_ADD, shutdown_fd, &ev );
+
+    for( int i = 0; i < num_threads; i++ )
+    {
+        const int cpu = ( first_cpu >= 0 ) ? first_cpu + i : -1;
+        ThreadPtr thread = std::make_shared<Thread>( std::string("can_reactor#") + std::to_string(i) );
+        thread->start( std::bind( &CanReceiveReactor::run, this, cpu ) );
+        threads.push_back( thread );
+    }
+}
+
+CanReceiveReactor::~CanReceiveReactor()
+{
+    uint64_t one = 1;
+    if( write( shutdown_fd, &one, sizeof(one) ) != sizeof(one) )
+    {
+        Log::CAN()->error("CanReceiveReactor: failed to notify the shutdown");
+    }
+    for( ThreadPtr& thread: threads ) { thread->join(); }
+
+    ::close( shutdown_fd );
+    ::close( epoll_fd );
+}
+
+void CanReceiveReactor::addPort(int fd, ReadableCallback callback)
+{
+    LockGuard lock( ports_mutex );
+    PortPtr port = std::make_shared<Port>();
+    port->callback = callback;
+    ports[fd] = port;
+
+    struct epoll_event ev;
+    ev.events  = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if( epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &ev ) != 0 )
+    {
+        ports.erase( ports.find( fd ) );
+        throw std::runtime_error("CanReceiveReactor: epoll_ctl failed");
+    }
+}
+
+// When this method returns, no reactor thread is using the port anymore
+// (unless it is called by the callback of the port itself).
+void CanReceiveReactor::removePort(int fd)
+{
+    LockGuard lock( ports_mutex );
+    epoll_ctl( epoll_fd, EPOLL_CTL_DEL, fd, NULL );
+
+    auto it = ports.find( fd );
+    if( it == ports.end() ) return;
+    PortPtr port = it->second;
+    ports.erase( it );
+
+    while( port->running_in != Thread::ID() && port->running_in != Thread::currentTid() )
+    {
+        port_idle.Wait( &ports_mutex );
+    }
+}
+
+bool CanReceiveReactor::isReactorThread(Thread::ID tid) const
+{
+    for( const ThreadPtr& thread: threads )
+    {
+        if( thread->tid() == tid ) return true;
+    }
+    return false;
+}
+
+void CanReceiveReactor::rearm(int fd)
+{
+    struct epoll_event ev;
+    ev.events  = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+    epoll_ctl( epoll_fd, EPOLL_CTL_MOD, fd, &ev );
+}
+
+void CanReceiveReactor::run(int cpu)
+{
+    Thread::setCurrentPriority( PRIORITY_CAN_READ );
+    if( cpu >= 0 )
+    {
+        Thread::setCurrentAffinity( cpu );
+    }
+    Log::CAN()->info("CanReceiveReactor thread started");
+
+    const int MAX_EVENTS = 16;
+    struct epoll_event events[MAX_EVENTS];
+
+    while( true )
+    {
+        int num = epoll_wait( epoll_fd, events, MAX_EVENTS, -1 );
+        if( num < 0 )
+        {
+            if( errno == EINTR ) continue;
+            Log::CAN()->error("CanReceiveReactor: epoll_wait failed");
+            return;
+        }
+
+        for( int i = 0; i < num; i++ )
+        {
+            const int fd = events[i].data.fd;
+            if( fd == shutdown_fd ) return;
+
+            PortPtr port;
+            {
+                // the port might have been removed after epoll_wait returned.
+                LockGuard lock( ports_mutex );
+                auto it = ports.find( fd );
+                if( it == ports.end() ) continue;
+                port = it->second;
+                port->running_in = Thread::currentTid();
+            }
+
+            // executed without locks: the callbacks of the port are allowed to close it.
+            port->callback();
+
+            LockGuard lock( ports_mutex );
+            port->running_in = Thread::ID();
+            port_idle.SignalAll();
+            auto it = ports.find( fd );
+            if( it != ports.end() && it->second == port )
+            {
+                rearm( fd );
+            }
+        }
+    }
+}
+#endif
+
+void enableCanReceiveReactor(int num_threads, int first_cpu)
+{
+#ifndef WIN32
+    if( !CMI::get().opened_can_ports.empty() )
+    {
+        throw std::runtime_error("enableCanReceiveReactor must be called before opening any CANPort");
+    }
+    if( num_threads < 1 ) num_threads = 1;
+    can_receive_reactor.reset( new CanReceiveReactor( num_threads, first_cpu ) );
+#else
+    throw std::runtime_error("enableCanReceiveReactor is not supported on this platform");
+#endif
+}
+
 //--------------------------------------------------------------
 
 CANPort::CANPort():  _d(new Impl)
@@ -91,6 +352,21 @@ CANPort::~CANPort()
     delete _d;
 }
 
+void CANPort::useSharedExecutor(bool shared)
+{
+    if( _d->opened )
+    {
+        throw std::runtime_error("CANPort::useSharedExecutor must be called before open");
+    }
+    _d->use_shared_executor = shared;
+}
+
+AsyncManager* CANPort::executor()
+{
+    if( _d->executor ) return _d->executor.get();
+    return &CMI::get().async_can;
+}
+
 void CANPort::traceSetSize(uint32_t s) { _d->trace_queue.resize(s);  }
 
 void CANPort::traceEnable(bool enable)
@@ -99,12 +375,15 @@ void CANPort::traceEnable(bool enable)
     _d->trace_enabled = enable;
 }
 
-void CANPort::Impl::tracePush(const CanMessage &m)
+void CANPort::Impl::tracePush(const CanMessage *m, int num_msgs)
 {
     LockGuard t(trace_mutex);
     if( trace_enabled)
     {
-        trace_queue.push_back( m );
+        for( int i = 0; i < num_msgs; i++ )
+        {
+            trace_queue.push_back( m[i] );
+        }
         printf("--trace push\n");
     }
 }
@@ -146,39 +425,171 @@ absl::any CANPort::subscribeCallback( CanRcvCallback callback,uint16_t mask, uin
     LockGuard t(_d->dispatcher_mutex);
 
     unique_id++;
-    Impl::SubscriptionInfo info;
-    info.callback = callback;
-    info.mask     = mask;
-    info.frame_id = frame_id;
+    std::shared_ptr<Impl::SubscriptionInfo> info = std::make_shared<Impl::SubscriptionInfo>();
+    info->callback = callback;
+    info->mask     = mask;
+    info->frame_id = frame_id;
     _d->subscribers.insert( std::make_pair( unique_id, info ) );
+    _d->publishDispatchTable();
+    _d->updateDriverFilter();
 
     return (unique_id);
 }
 
 void CANPort::unsubscribeCallback(const absl::any& cb_id )
 {
+    uint64_t epoch = 0;
+    {
+        LockGuard t(_d->dispatcher_mutex);
+        int key =  absl::any_cast<int>(cb_id);
+        _d->subscribers.erase( _d->subscribers.find(key) );
+        _d->publishDispatchTable();
+        _d->updateDriverFilter();
+        epoch = _d->reader_epoch.load();
+    }
+
+    // the caller is allowed to destroy the objects used by the callback as soon as
+    // we return, therefore we must be sure that the receive thread isn't executing it.
+    // The mutex is released first: the callback being executed might (un)subscribe too.
+    _d->waitReadersQuiescent( epoch );
+}
+
+// Must be called with dispatcher_mutex locked.
+void CANPort::Impl::publishDispatchTable()
+{
+    DispatchTable* table = new DispatchTable;
+
+    // iterate in order of subscription, as the old linear dispatcher did.
+    for( auto& it: subscribers )
+    {
+        const SubscriptionPtr& sub = it.second;
+        if( !sub->callback ) continue;
+
+        table->owners.push_back( sub );
+        for( uint16_t cobid = 0; cobid < COB_ID_TABLE_SIZE; cobid++ )
+        {
+            if( sub->frame_id == (cobid & sub->mask ) )
+            {
+                table->by_cob_id[cobid].push_back( &sub->callback );
+            }
+        }
+    }
+
+    const DispatchTable* old_table = dispatch_table.exchange( table );
+
+    RetiredTable retired;
+    retired.table        = old_table;
+    retired.reader_epoch = reader_epoch.load();
+    retired_tables.push_back( retired );
+
+    // reclaim the tables that can't be referenced by the receive thread anymore.
+    const uint64_t epoch = reader_epoch.load();
+    for( auto it = retired_tables.begin(); it != retired_tables.end(); )
+    {
+        if( (it->reader_epoch % 2) == 0 || epoch > it->reader_epoch )
+        {
+            delete it->table;
+            it = retired_tables.erase( it );
+        }
+        else{
+            ++it;
+        }
+    }
+}
+
+bool CANPort::enableDriverFilter(bool enable)
+{
+    if( !canSetFilters_driver )
+    {
+        Log::CAN()->warn("The CAN driver doesn't support filtering");
+        return false;
+    }
+
     LockGuard t(_d->dispatcher_mutex);
-    int key =  absl::any_cast<int>(cb_id);
-    _d->subscribers.erase( _d->subscribers.find(key) );
+    if( _d->driver_filter_enabled && !enable )
+    {
+        // accept everything again
+        const uint16_t mask = 0, frame_id = 0;
+        canSetFilters_driver( _d->handle, &mask, &frame_id, 1 );
+    }
+    _d->driver_filter_enabled = enable;
+    _d->updateDriverFilter();
+    return true;
+}
+
+// Must be called with dispatcher_mutex locked.
+void CANPort::Impl::updateDriverFilter()
+{
+    if( !driver_filter_enabled || !opened ) return;
+
+    std::vector<uint16_t> masks;
+    std::vector<uint16_t> frame_ids;
+
+    for( auto& it: subscribers )
+    {
+        const SubscriptionPtr& sub = it.second;
+        if( !sub->callback ) continue;
+
+        const uint16_t frame_id = sub->frame_id & sub->mask;
+        if( sub->mask == 0 )
+        {
+            // this subscriber wants everything: no filter can be applied.
+            masks.assign( 1, 0 );
+            frame_ids.assign( 1, 0 );
+            break;
+        }
+        bool duplicated = false;
+        for( size_t i = 0; i < masks.size(); i++ )
+        {
+            duplicated |= ( masks[i] == sub->mask && frame_ids[i] == frame_id );
+        }
+        if( !duplicated )
+        {
+            masks.push_back( sub->mask );
+            frame_ids.push_back( frame_id );
+        }
+    }
+
+    int rc = canSetFilters_driver( handle, masks.data(), frame_ids.data(), masks.size() );
+    if( rc != 0 )
+    {
+        Log::CAN()->error("canSetFilters_driver returned {}", rc);
+    }
 }
 
-void CANPort::Impl::dispatchMessage(const CanMessage& m )
+// Wait until the receive thread is done with the snapshot it was using when reader_epoch was equal to epoch.
+// Must be called with dispatcher_mutex unlocked.
+void CANPort::Impl::waitReadersQuiescent(uint64_t epoch)
 {
-    LockGuard t( dispatcher_mutex );
+    // a callback that unsubscribes from inside the receive thread would wait for itself.
+    if( (epoch % 2) == 0 || tls_dispatching_port == this )
+    {
+        return;
+    }
+    while( reader_epoch.load() == epoch )
+    {
+        Thread::yield();
+    }
+}
 
-    Log::CAN()->debug("recv: {}", m );
+// The same snapshot of the subscribers is used for the entire burst of messages.
+void CANPort::Impl::dispatchMessages(const CanMessage* m, int num_msgs )
+{
+    tls_dispatching_port = this;
+    reader_epoch.fetch_add(1);
+    const DispatchTable* table = dispatch_table.load();
 
-    std::map<int,SubscriptionInfo>::iterator it;
-    for( it = subscribers.begin(); it != subscribers.end(); it++ )
+    for( int i = 0; i < num_msgs; i++ )
     {
-        Impl::SubscriptionInfo* sub = & (it->second);
-        uint16_t cobid = m.cob_id;
+        Log::CAN()->debug("recv: {}", m[i] );
 
-        if( (sub->frame_id == (cobid &  sub->mask ))  && sub->callback )
+        for( const CanRcvCallback* callback: table->by_cob_id[ m[i].cob_id ] )
         {
-            sub->callback( m );
+            (*callback)( m[i] );
         }
     }
+    reader_epoch.fetch_add(1);
+    tls_dispatching_port = NULL;
 }
 
 int16_t CANPort::Impl::receive(CanMessage *m)
@@ -192,8 +603,11 @@ bool isCanReadThread()
     Thread::ID my_tid = Thread::currentTid();
     for( auto& canport: CMI::get().opened_can_ports )
     {
-        if( canport->_d->receive_task->tid() ==  my_tid ) { return true; }
+        if( canport->_d->receive_task && canport->_d->receive_task->tid() ==  my_tid ) { return true; }
     }
+#ifndef WIN32
+    if( can_receive_reactor && can_receive_reactor->isReactorThread( my_tid ) ) { return true; }
+#endif
     return false;
 }
 
@@ -214,40 +628,139 @@ int16_t CANPort::send( CanMessage* m )
     m->sent     = true;
 
     //TO TEST async_service.addImmediateCallback( std::bind( &CANPort::Impl::tracePush, _d, *m ) );
-     _d->tracePush( *m );
+     _d->tracePush( m );
 
     Log::CAN()->debug("sent: {}", *m);
 
     return err;
 }
 
-void CANPort::Impl::receiveLoop()
+int16_t CANPort::sendBatch( CanMessage* msgs, int num_msgs )
 {
-    CanMessage m;
+    assert( canOpen_driver != NULL );
 
-    Log::CAN()->info("canReceiveLoop started");
-    Thread::setCurrentPriority( PRIORITY_CAN_READ );
+    if( num_msgs <= 0 ) return 0;
 
-    while( opened )
+    const uint64_t now_usec = std::chrono::duration_cast<Microseconds>( GetTimeNow().time_since_epoch() ).count();
+    for( int i = 0; i < num_msgs; i++ )
+    {
+        msgs[i].timestamp_usec = now_usec;
+    }
+
+    int num_sent = 0;
+    while( num_sent < num_msgs )
     {
-        int rc = this->receive(&m);
-        if( rc < 0 && opened )
+        int rc = 0;
+        if( canSendBatch_driver )
         {
-            throw std::runtime_error("Error with CAN receive");
+            // the driver might accept only a part of the burst.
+            rc = canSendBatch_driver( _d->handle, &msgs[num_sent], num_msgs - num_sent );
+        }
+        else{
+            int err = canSend_driver( _d->handle, &msgs[num_sent] );
+            // canSend_driver returns a non zero error code, that might be positive.
+            rc = (err == 0) ? 1 : ( err < 0 ? err : -err );
+        }
+
+        if( rc <= 0 )
+        {
+            Log::CAN()->error("canSendBatch: driver returned {} after {} messages", rc, num_sent );
+            _d->tracePush( msgs, num_sent );
+            return (rc < 0) ? rc : -1;
+        }
+        for( int i = num_sent; i < num_sent + rc; i++ )
+        {
+            msgs[i].received = false;
+            msgs[i].sent     = true;
         }
-        if( rc == 0)
+        num_sent += rc;
+    }
+
+    _d->tracePush( msgs, num_msgs );
+
+    if( Log::CAN()->should_log( spdlog::level::debug ) )
+    {
+        for( int i = 0; i < num_msgs; i++ )
         {
-            m.timestamp_usec = std::chrono::duration_cast<Microseconds>( GetTimeNow().time_since_epoch() ).count();
+            Log::CAN()->debug("sent: {}", msgs[i]);
+        }
+    }
+    return 0;
+}
+
+// The drivers timestamp the frames with the wall clock (see CAN_driver.h), CanMessage::timestamp_usec uses
+// the clock of GetTimeNow(): the age of the frame is measured on the wall clock and subtracted from now.
+// A frame that seems to come from the future, or too old, is the result of a step of the wall clock.
+static uint64_t driverTimestampToLocal(uint64_t driver_usec, uint64_t wall_now_usec, uint64_t now_usec)
+{
+    const uint64_t MAX_AGE_USEC = 1000*1000;
+    if( driver_usec > wall_now_usec || wall_now_usec - driver_usec > MAX_AGE_USEC )
+    {
+        return now_usec;
+    }
+    return now_usec - ( wall_now_usec - driver_usec );
+}
+
+// Read the available messages (or wait for them until the driver timeout expires) and dispatch them.
+// Returns the number of messages or a negative error code.
+int CANPort::Impl::receiveAndDispatch()
+{
+    CanMessage* msgs = receive_buffer;
+    const int batch_size = canReceiveBatch_driver ? RECEIVE_BATCH_SIZE : 1;
+
+    // drivers that support RX timestamps overwrite this field.
+    for( int i = 0; i < batch_size; i++ ) { msgs[i].timestamp_usec = 0; }
+
+    int num_msgs = 0;
+    if( canReceiveBatch_driver )
+    {
+        num_msgs = canReceiveBatch_driver( handle, msgs, batch_size );
+    }
+    else{
+        int rc = this->receive( &msgs[0] );
+        // Note if rc == 1 it is a timeout. No dispatching and no throw
+        num_msgs = (rc == 0) ? 1 : ( rc < 0 ? rc : 0 );
+    }
+
+    if( num_msgs > 0 )
+    {
+        const uint64_t now_usec = std::chrono::duration_cast<Microseconds>( GetTimeNow().time_since_epoch() ).count();
+        const uint64_t wall_now_usec = std::chrono::duration_cast<Microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch() ).count();
+
+        for( int i = 0; i < num_msgs; i++ )
+        {
+            CanMessage& m = msgs[i];
+            // prefer the timestamp provided by the driver: it doesn't include the wake-up latency.
+            if( m.timestamp_usec == 0 )
+            {
+                m.timestamp_usec = now_usec;
+            }
+            else{
+                m.timestamp_usec = driverTimestampToLocal( m.timestamp_usec, wall_now_usec, now_usec );
+            }
             m.received = true;
             m.sent     = false;
+        }
+        // TO TEST async_service.addImmediateCallback( std::bind( &CANPort::Impl::tracePush, this, m ) );
+        tracePush( msgs, num_msgs );
+        this->dispatchMessages( msgs, num_msgs );
+    }
+    return num_msgs;
+}
 
-            // TO TEST async_service.addImmediateCallback( std::bind( &CANPort::Impl::tracePush, this, m ) );
-            // TO TEST async_service.addImmediateCallback( std::bind( &CANPort::Impl::dispatchMessage, this, m ) );
+void CANPort::Impl::receiveLoop()
+{
+    Log::CAN()->info("canReceiveLoop started");
+    Thread::setCurrentPriority( PRIORITY_CAN_READ );
 
-             tracePush( m );
-             this->dispatchMessage( m );
+    while( opened )
+    {
+        int num_msgs = receiveAndDispatch();
+        if( num_msgs < 0 && opened )
+        {
+            throw std::runtime_error("Error with CAN receive");
         }
-        // Note if rc == 1 it is a timeout. No dispatching and no throw
 
 #ifdef __KERNEL__
 #ifdef USE_XENO
@@ -260,7 +773,8 @@ void CANPort::Impl::receiveLoop()
 }
 
 
-CANPortPtr openCanPort(const char* busname, const char* bitrate )
+
+CANPortPtr openCanPort(const char* busname, const char* bitrate, bool shared_executor )
 {
     if ( !canOpen_driver )
     {
@@ -278,6 +792,7 @@ CANPortPtr openCanPort(const char* busname, const char* bitrate )
 
     // let's open a new port
     CANPortPtr new_port( new CANPort );
+    new_port->useSharedExecutor( shared_executor );
     if( new_port->open( busname, bitrate ) == 0)
     {
         CMI::get().opened_can_ports.push_back( new_port );
@@ -297,8 +812,32 @@ int16_t CANPort::open( const char* busname, const char* bitrate )
         _d->handle  = handle;
         _d->opened  = true;
         _d->busname.assign( busname );
-        _d->receive_task = std::make_shared<Thread>();
-        _d->receive_task->start( std::bind( &CANPort::Impl::receiveLoop, _d ) );
+        if( !_d->use_shared_executor && !_d->executor )
+        {
+            _d->executor = std::make_shared<AsyncManager>( Thread::PRIO_NORMAL );
+        }
+        {
+            LockGuard t( _d->dispatcher_mutex );
+            _d->updateDriverFilter();
+        }
+#ifndef WIN32
+        if( can_receive_reactor )
+        {
+            Impl* port = _d;
+            can_receive_reactor->addPort( handle.fd, [port]()
+            {
+                if( port->opened && port->receiveAndDispatch() < 0 && port->opened )
+                {
+                    Log::CAN()->error("Error with CAN receive on {}", port->busname);
+                }
+            });
+        }
+        else
+#endif
+        {
+            _d->receive_task = std::make_shared<Thread>();
+            _d->receive_task->start( std::bind( &CANPort::Impl::receiveLoop, _d ) );
+        }
         this->status( );
         return 0;
     }
@@ -311,13 +850,28 @@ int16_t CANPort::open( const char* busname, const char* bitrate )
 int16_t CANPort::close( )
 {
     uint8_t res=0;
+    // As in CMI::~CMI, stop the executor before the port.
+    if( _d->executor )
+    {
+        _d->executor->kill();
+    }
+#ifndef WIN32
+    if( can_receive_reactor && !_d->receive_task )
+    {
+        // no need to wait for the driver timeout: the reactor stops using the port immediately.
+        can_receive_reactor->removePort( _d->handle.fd );
+    }
+#endif
     {
         LockGuard t( _can_driver_mutex_);
         _d->opened = false;
         // close CAN port
         res = canClose_driver( _d->handle );
     }
-    _d->receive_task->join();
+    if( _d->receive_task )
+    {
+        _d->receive_task->join();
+    }
 
     return res;
 }
@@ -354,6 +908,17 @@ std::function<T> loadSymbol( std::string const& functionName )
     return reinterpret_cast<T*>( result );
 }
 
+// Same as loadSymbol, but returns an empty function if the driver doesn't provide the symbol.
+template<class T>
+std::function<T> loadOptionalSymbol( std::string const& functionName )
+{
+    if( !CAN_driver_shared_library.hasSymbol( functionName ) )
+    {
+        return std::function<T>();
+    }
+    return loadSymbol<T>( functionName );
+}
+
 
 void LoadCanDriver( const char* driver_name )
 {
@@ -373,6 +938,18 @@ void LoadCanDriver( const char* driver_name )
     canSend_driver    = loadSymbol< int( CAN_Handle_t, CanMessage const* )>("canSend_driver" );
     canReceive_driver = loadSymbol< int( CAN_Handle_t, CanMessage* )>("canReceive_driver" );
     canStatus_driver  = loadSymbol< int( CAN_Handle_t )>("canStatus_driver" );
+
+    canReceiveBatch_driver = loadOptionalSymbol< int( CAN_Handle_t, CanMessage*, int )>("canReceiveBatch_driver" );
+    if( canReceiveBatch_driver )
+    {
+        Log::CAN()->info("{} supports batched receive", driver_name);
+    }
+    canSendBatch_driver = loadOptionalSymbol< int( CAN_Handle_t, CanMessage const*, int )>("canSendBatch_driver" );
+    if( canSendBatch_driver )
+    {
+        Log::CAN()->info("{} supports batched transmission", driver_name);
+    }
+    canSetFilters_driver = loadOptionalSymbol< int( CAN_Handle_t, uint16_t const*, uint16_t const*, int )>("canSetFilters_driver" );
 }
 
 
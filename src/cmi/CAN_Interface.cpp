@@ -11,6 +11,7 @@
 
 
 #include <cerrno>
+#include <atomic>
 #include <boost/lockfree/queue.hpp>
 #include "cmi/CAN_Interface.h"
 #include "cmi/ObjectDictionary.h"
@@ -27,20 +28,72 @@ class CanInterface::Impl
 {
 public:
 
+    CanInterface* self;
     uint16_t     device_id;
     uint8_t		 node_id;
 
-    // Note: the mutex is not used to push/pop form the can_write_fifo queue, but
+    // Transmission lanes, served in this order. FRONT_LANE contains the messages pushed with push_front.
+    enum{ REALTIME_LANE = 0, FRONT_LANE, NORMAL_LANE, BACKGROUND_LANE, NUM_LANES };
+
+    // Each lane grows on demand up to MAX_QUEUED_MESSAGES.
+    enum{ INITIAL_LANE_CAPACITY = 50, MAX_QUEUED_MESSAGES = 1024 };
+
+    struct TxLaneQueue
+    {
+        boost::lockfree::queue<CanMessage>  fifo;
+        std::atomic<int>                    size;
+        TxLaneQueue(): fifo( INITIAL_LANE_CAPACITY ), size(0) {}
+    };
+
+    // Note: the mutex is not used to push/pop form the lanes, but
     // it is needed by condition_queue_empty
     Mutex        fifo_mutex;
-    boost::lockfree::queue<CanMessage>  can_write_fifo;
+    TxLaneQueue  can_write_lanes[NUM_LANES];
+
+    bool lanesEmpty() const
+    {
+        for( int i = 0; i < NUM_LANES; i++ )
+        {
+            if( can_write_lanes[i].size.load() > 0 ) return false;
+        }
+        return true;
+    }
+
+    bool popFromLane(int lane, CanMessage* m)
+    {
+        if( can_write_lanes[lane].fifo.pop( *m ) )
+        {
+            can_write_lanes[lane].size--;
+            return true;
+        }
+        return false;
+    }
+
+    int  pushToLane(int lane, const CanMessage& m);
 
     typedef enum{ WAITING, WAITING_ANSWER, DONT_WAIT} WaitingState;
 
+    // max number of queued messages given to CANPort::sendBatch at once.
+    enum{ MAX_BURST_SIZE = 32 };
+
     CANPortPtr				 can_port;
 
     AsyncManager::Handle_t	 timeout_handle;
-    Microseconds			 reply_timeout;
+    Microseconds			 reply_timeout;   // current timeout (adaptive or fixed)
+
+    // Adaptive timeout, computed like the TCP retransmission timeout (RFC 6298):
+    //   timeout = smoothed_rtt + 4 * rtt_variation, clamped to [timeout_floor, timeout_ceiling].
+    // The round trip is measured from the transmission of a message that needs an answer
+    // to the reception timestamp of the answer. It is doubled after each timeout.
+    bool                     adaptive_timeout;
+    Microseconds             timeout_floor;
+    Microseconds             timeout_ceiling;
+    TimePoint                last_msg_sent_time;
+    mutable Mutex            rtt_mutex;
+    RttStatistics            rtt;
+
+    void updateRoundTripTime(Microseconds sample);
+    void backoffTimeout();
     absl::any                subscriber;
 
 
@@ -52,9 +105,22 @@ public:
     TimePoint       queue_wait_abs_timeout;
 
     std::vector<InterpreterCallback>  interpreters_list;
+
+    // Interpreters registered as non_blocking. If inline_interpreters_enabled, they are executed
+    // by the receive thread of the CANPort, otherwise by async_can after interpreters_list.
+    RW_Mutex                          inline_mutex;
+    std::vector<InterpreterCallback>  inline_interpreters;
+    std::atomic<bool>                 inline_interpreters_enabled;
+
+    // cob_id of the last answer the queue waited for. Read by the receive thread to know if a
+    // message interpreted inline must be forwarded to async_can anyway, to unblock the queue.
+    std::atomic<uint32_t>             last_desired_answer;
     EventDispatcher  event_dispatcher;
 
-    AsyncManager *async_can;
+    AsyncManager *async_can; // executor of can_port
+
+    /** Send all the messages of the REALTIME_LANE. Returns false if the driver failed.*/
+    bool sendRealtimeLane();
 
     /** Try send message is non blocking. It will be called when:
      * - a new message is pushed using pushMessage.
@@ -70,31 +136,43 @@ public:
     /** This callback is executed in the thread of _d->async_can->
      * It calls more callbacks (the interpreters_list).
      * We do not know how long these interpreters will take.
+     * If interpreted_inline is true, the inline_interpreters were executed already.
      */
-    void msgReceivedCallback_Async(const CanMessage m);
+    void msgReceivedCallback_Async(const CanMessage m, bool interpreted_inline);
+
+    bool runInlineInterpreters(const CanMessage & m);
 
     /** Non blocking*/
-    void timeout_callback(const char* msg);
+    void timeout_callback(std::string msg);
 
     /** Added to make the access at interpreters_list thread safe. */
     void AddReadInterpreter_Async(InterpreterCallback call);
 
 
-    Impl(): can_write_fifo(50),
+    Impl():
         last_msg_wait_answer (DONT_WAIT),
         num_msg_sent(0),
         num_msg_received(0),
         queue_wait_abs_timeout( TimePoint::max() ),
-        async_can( &CMI::get().async_can )
+        inline_interpreters_enabled( false ),
+        last_desired_answer( 0xFFFF ),
+        async_can( NULL )
     {}
 };
 
 CanInterface::CanInterface(CANPortPtr can_port, uint16_t device_id , uint16_t sub_value, uint16_t sub_mask):
     _d( new Impl )
 {
+    _d->self       = this;
     _d->device_id  = device_id;
     _d->can_port   = can_port;
+    _d->async_can  = can_port->executor();
     _d->reply_timeout  = Milliseconds(200);
+    _d->adaptive_timeout = false;
+    _d->timeout_floor    = Milliseconds(200);
+    _d->timeout_ceiling  = Milliseconds(200);
+    _d->rtt = RttStatistics();
+    _d->rtt.current_timeout = _d->reply_timeout;
     _d->timeout_handle = _d->async_can->addAlarm();
 
     CanRcvCallback callback =  std::bind( &CanInterface::Impl::msgReceivedCallback_Sync, _d, std::placeholders::_1 );
@@ -116,19 +194,87 @@ EventDispatcher* CanInterface::events()
 
 void CanInterface::setReadTimeout(Microseconds usec)
 {
+    LockGuard lock( _d->rtt_mutex );
+    _d->adaptive_timeout = false;
     _d->reply_timeout = usec;
+    _d->rtt.current_timeout = usec;
+}
+
+void CanInterface::setAdaptiveReadTimeout(Microseconds floor, Microseconds ceiling)
+{
+    if( floor > ceiling )
+    {
+        throw std::runtime_error("CanInterface::setAdaptiveReadTimeout: floor > ceiling");
+    }
+    LockGuard lock( _d->rtt_mutex );
+    _d->adaptive_timeout = true;
+    _d->timeout_floor   = floor;
+    _d->timeout_ceiling = ceiling;
+    // until the next sample, use the most conservative value.
+    _d->reply_timeout = ( _d->rtt.num_samples > 0 ) ? std::min( std::max( _d->reply_timeout, floor ), ceiling ) : ceiling;
+    _d->rtt.current_timeout = _d->reply_timeout;
 }
 
 Microseconds CanInterface::getReadTimeout()
 {
+    LockGuard lock( _d->rtt_mutex );
     return _d->reply_timeout ;
 }
 
+RttStatistics CanInterface::getRttStatistics() const
+{
+    LockGuard lock( _d->rtt_mutex );
+    return _d->rtt;
+}
+
+void CanInterface::Impl::updateRoundTripTime(Microseconds sample)
+{
+    LockGuard lock( rtt_mutex );
+    if( rtt.num_samples == 0 )
+    {
+        rtt.smoothed  = sample;
+        rtt.variation = sample / 2;
+        rtt.min = sample;
+        rtt.max = sample;
+    }
+    else{
+        const Microseconds error = ( rtt.smoothed > sample ) ? ( rtt.smoothed - sample ) : ( sample - rtt.smoothed );
+        rtt.variation = ( rtt.variation * 3 + error ) / 4;
+        rtt.smoothed  = ( rtt.smoothed * 7 + sample ) / 8;
+        rtt.min = std::min( rtt.min, sample );
+        rtt.max = std::max( rtt.max, sample );
+    }
+    rtt.last = sample;
+    rtt.num_samples++;
+
+    if( adaptive_timeout )
+    {
+        reply_timeout = std::min( std::max( rtt.smoothed + rtt.variation * 4, timeout_floor ), timeout_ceiling );
+        rtt.current_timeout = reply_timeout;
+    }
+}
+
+void CanInterface::Impl::backoffTimeout()
+{
+    LockGuard lock( rtt_mutex );
+    rtt.num_timeouts++;
+    if( adaptive_timeout )
+    {
+        reply_timeout = std::min( reply_timeout * 2, timeout_ceiling );
+        rtt.current_timeout = reply_timeout;
+    }
+}
+
 CanMessage const& CanInterface::getLastMsgSent()
 {
     return  _d->last_msg_sent;
 }
 
+TimePoint CanInterface::getLastMsgSentTime()
+{
+    return  _d->last_msg_sent_time;
+}
+
 CanMessage const& CanInterface::getLastMsgReceived()
 {
     return  _d->last_msg_received;
@@ -140,7 +286,10 @@ void CanInterface::cleanCanSendBuffer()
     //even if this is thread safe, we need the lock to make happy the
     // condition variable inside waitQueueEmpty
     LockGuard t( _d->fifo_mutex) ;
-    while( _d->can_write_fifo.pop( tmp ) );
+    for( int lane = 0; lane < Impl::NUM_LANES; lane++ )
+    {
+        while( _d->popFromLane( lane, &tmp ) );
+    }
 }
 
 uint16_t CanInterface::device_ID() const { return _d->device_id; }
@@ -158,29 +307,92 @@ bool CanInterface::waitQueueEmpty( Microseconds timeout )
 
     absl::Condition is_queue_empty (+[](CanInterface::Impl* _d)
     {
-        return (_d->can_write_fifo.empty() &&
+        return (_d->lanesEmpty() &&
                 _d->last_msg_wait_answer == CanInterface::Impl::DONT_WAIT);
     }, _d );
 
+    LockGuard t( _d->fifo_mutex );
     bool done = _d->fifo_mutex.AwaitWithTimeout(is_queue_empty, absl::FromChrono( timeout ) );
 
     return done;
 }
 
-int CanInterface::pushMessage( const CanMessage& m, bool push_front )
+int CanInterface::Impl::pushToLane(int lane, const CanMessage& m)
 {
-    _d->can_write_fifo.push( m );
+    if( can_write_lanes[lane].size.fetch_add(1) >= MAX_QUEUED_MESSAGES )
+    {
+        can_write_lanes[lane].size--;
+        Log::CAN()->error("CanInterface {}: TX queue full, message dropped: {}", device_id, m );
+        return 0;
+    }
+    can_write_lanes[lane].fifo.push( m );
 
-    _d->async_can->addImmediateCallback( std::bind( &CanInterface::Impl::trySendMessage, _d ) );
+    Impl* d = this;
+    async_can->addImmediateTask( [d]() { d->trySendMessage(); } );
     return 1;
 }
 
+// Messages pushed without a lane keep the FIFO order of the queue: for instance an NMT
+// state change must not overtake the SDOs queued before it.
+int CanInterface::pushMessage( const CanMessage& m, bool push_front )
+{
+    if( push_front )
+    {
+        return _d->pushToLane( Impl::FRONT_LANE, m );
+    }
+    return _d->pushToLane( Impl::NORMAL_LANE, m );
+}
+
+int CanInterface::pushMessage( const CanMessage& m, TxLane lane )
+{
+    switch( lane )
+    {
+    case TX_LANE_REALTIME:
+        if( m.wait_answer == static_cast<uint32_t>(NEED_TO_WAIT_ANSWER) )
+        {
+            throw std::runtime_error("CanInterface::pushMessage: the real-time lane can't wait for an answer");
+        }
+        return _d->pushToLane( Impl::REALTIME_LANE, m );
+    case TX_LANE_BACKGROUND:
+        return _d->pushToLane( Impl::BACKGROUND_LANE, m );
+    default:
+        return _d->pushToLane( Impl::NORMAL_LANE, m );
+    }
+}
+
+bool CanInterface::Impl::sendRealtimeLane()
+{
+    CanMessage burst[MAX_BURST_SIZE];
+    while( true )
+    {
+        int burst_size = 0;
+        while( burst_size < MAX_BURST_SIZE && popFromLane( REALTIME_LANE, &burst[burst_size] ) )
+        {
+            burst_size++;
+        }
+        if( burst_size == 0 ) return true;
+
+        if( can_port->sendBatch( burst, burst_size ) != 0 )
+        {
+            return false;
+        }
+        num_msg_sent += burst_size;
+    }
+}
+
 void CanInterface::Impl::trySendMessage()
 {
     //even if this is thread safe, we need the lock to make happy the
     // condition variable inside waitQueueEmpty
     LockGuard t( fifo_mutex) ;
 
+    // the real-time lane never waits for the answers of the other lanes.
+    if( !sendRealtimeLane() )
+    {
+        Log::CAN()->error("failed to send a message... CAN down?" );
+        throw std::runtime_error("failed to send a message.");
+    }
+
     if( last_msg_wait_answer != DONT_WAIT  )
     {
         TimePoint now = GetTimeNow();
@@ -197,17 +409,35 @@ void CanInterface::Impl::trySendMessage()
         }
     }
     //the case _last_msg_need_answer == NO_WAIT is neutral, you don't need to consider it
-    while( can_write_fifo.empty() == false )
+    while( true )
     {
-        CanMessage msg_to_send;
-        can_write_fifo.pop( msg_to_send );
+        // Collect a burst of messages that can be sent with a single call to the driver.
+        // The burst is taken from the first lane that isn't empty and ends with the first
+        // message that needs to wait for an answer.
+        CanMessage burst[MAX_BURST_SIZE];
+        int burst_size = 0;
+
+        for( int lane = FRONT_LANE; lane < NUM_LANES && burst_size == 0; lane++ )
+        {
+            while( burst_size < MAX_BURST_SIZE && popFromLane( lane, &burst[burst_size] ) )
+            {
+                burst_size++;
+                if( burst[burst_size-1].wait_answer == static_cast<uint32_t>(NEED_TO_WAIT_ANSWER) )
+                {
+                    break;
+                }
+            }
+        }
+        if( burst_size == 0 ) break;
 
-        //send the CanMessage on the can device
-        if( can_port->send( &msg_to_send ) == 0 ) // if it is succesfull
+        //send the CanMessages on the can device
+        if( can_port->sendBatch( burst, burst_size ) == 0 ) // if it is succesfull
         {
-            last_msg_sent = msg_to_send;
+            last_msg_sent = burst[burst_size-1];
+            // the timestamp of the answer is taken by CANPort on the same clock.
+            last_msg_sent_time = TimePoint() + Microseconds( last_msg_sent.timestamp_usec );
 
-            num_msg_sent++;
+            num_msg_sent += burst_size;
             // default
             last_msg_wait_answer = DONT_WAIT;
             if( last_msg_sent.wait_answer == static_cast<uint32_t>(NEED_TO_WAIT_ANSWER) )
@@ -217,12 +447,19 @@ void CanInterface::Impl::trySendMessage()
                     throw std::runtime_error("wait_answer =  NEED_TO_WAIT_ANSWER, but you forgot to set desired_answer" );
                 }
                 last_msg_wait_answer = WAITING_ANSWER;
+                last_desired_answer  = last_msg_sent.desired_answer;
 
-                static char temp[20];
+                // each port has its own executor: the text is bound by value.
+                char temp[20];
                 sprintf(temp, "COD_ID: 0x%X",last_msg_sent.desired_answer);
-                AsyncManager::Callback_t callback = std::bind( &CanInterface::Impl::timeout_callback, this,  temp );
+                AsyncManager::Callback_t callback = std::bind( &CanInterface::Impl::timeout_callback, this, std::string(temp) );
 
-                async_can->setAlarm( timeout_handle, callback, reply_timeout );
+                Microseconds timeout;
+                {
+                    LockGuard lock( rtt_mutex );
+                    timeout = reply_timeout;
+                }
+                async_can->setAlarm( timeout_handle, callback, timeout );
                 return;  //stop the while loop
             }
         }
@@ -230,35 +467,69 @@ void CanInterface::Impl::trySendMessage()
             Log::CAN()->error("failed to send a message... CAN down?" );
             throw std::runtime_error("failed to send a message.");
         }
+
+        // real-time messages pushed in the meantime go first.
+        if( !sendRealtimeLane() )
+        {
+            Log::CAN()->error("failed to send a message... CAN down?" );
+            throw std::runtime_error("failed to send a message.");
+        }
     }// end while
 
     // you get here only if the queue is empty
     return;
 }
 
-int timeout_counter_to_exit = 0;
-
-void CanInterface::Impl::timeout_callback(const char* msg)
+void CanInterface::Impl::timeout_callback(std::string msg)
 {
-    if( last_msg_wait_answer == WAITING_ANSWER )
+    const bool expired = ( last_msg_wait_answer == WAITING_ANSWER );
+    if( expired )
     {
-        Log::CAN()->warn("*** timeout. *** Sender: {}", last_msg_sent );
+        Log::CAN()->warn("*** timeout waiting {} *** Sender: {}", msg, last_msg_sent );
+        backoffTimeout();
     }
     else {
         Log::CAN()->debug("harmless timeout" ) ;
     }
     last_msg_wait_answer = DONT_WAIT;
 
-    async_can->addImmediateCallback( std::bind( &CanInterface::Impl::trySendMessage, this  ) );
+    if( expired )
+    {
+        self->answerTimeout( last_msg_sent );
+    }
+
+    async_can->addImmediateTask( [this]() { trySendMessage(); } );
 }
 
 
+bool CanInterface::Impl::runInlineInterpreters(const CanMessage & m)
+{
+    bool recognized = false;
+    ScopedReadLock lock( &inline_mutex );
+    for( unsigned i = 0; i < inline_interpreters.size(); i++ )
+    {
+        recognized |= ( inline_interpreters[i] )( m );
+    }
+    return recognized;
+}
+
 void CanInterface::Impl::msgReceivedCallback_Sync( const CanMessage& m )
 {
-    async_can->addImmediateCallback( std::bind( &CanInterface::Impl::msgReceivedCallback_Async, this, m  ) );
+    bool interpreted_inline = false;
+    if( inline_interpreters_enabled.load( std::memory_order_relaxed ) )
+    {
+        interpreted_inline = true;
+        // fast path: nothing else to do, unless the queue might be waiting for this message.
+        if( runInlineInterpreters( m ) && m.cob_id != last_desired_answer.load() )
+        {
+            return;
+        }
+    }
+    // the message is copied inside the task: no allocation per frame.
+    async_can->addImmediateTask( [this, m, interpreted_inline]() { msgReceivedCallback_Async( m, interpreted_inline ); } );
 }
 
-void CanInterface::Impl::msgReceivedCallback_Async( const CanMessage m )
+void CanInterface::Impl::msgReceivedCallback_Async( const CanMessage m, bool interpreted_inline )
 {
     bool recognized = false;
     {
@@ -274,6 +545,10 @@ void CanInterface::Impl::msgReceivedCallback_Async( const CanMessage m )
         {
             recognized |= ( interpreters_list[i] )( m );
         }
+        if( !interpreted_inline )
+        {
+            recognized |= runInlineInterpreters( m );
+        }
 
         if( !recognized && m.getNode() == node_id)
         {
@@ -286,10 +561,16 @@ void CanInterface::Impl::msgReceivedCallback_Async( const CanMessage m )
             // Log::CAN()->debug() << "cancel timer" ;
             async_can->delAlarm( timeout_handle );
             last_msg_wait_answer = DONT_WAIT;
+
+            TimePoint received_time = TimePoint() + Microseconds( m.timestamp_usec );
+            if( received_time >= last_msg_sent_time )
+            {
+                updateRoundTripTime( std::chrono::duration_cast<Microseconds>( received_time - last_msg_sent_time ) );
+            }
         }
     }
 
-    async_can->addImmediateCallback( std::bind( &CanInterface::Impl::trySendMessage, this ) );
+    async_can->addImmediateTask( [this]() { trySendMessage(); } );
 
     return;
 }
@@ -299,9 +580,22 @@ void CanInterface::Impl::AddReadInterpreter_Async(InterpreterCallback call)
     interpreters_list.push_back(call);
 }
 
-void CanInterface::addReadInterpreter(InterpreterCallback call)
+void CanInterface::addReadInterpreter(InterpreterCallback call, bool non_blocking)
+{
+    if( non_blocking )
+    {
+        ScopedWriteLock lock( &_d->inline_mutex );
+        _d->inline_interpreters.push_back( call );
+        return;
+    }
+    // same queue of the received messages, to keep the order.
+    Impl* d = _d;
+    _d->async_can->addImmediateTask( [d, call]() { d->AddReadInterpreter_Async( call ); } );
+}
+
+void CanInterface::enableInlineInterpreters(bool enable)
 {
-    _d->async_can->addImmediateCallback( std::bind( &CanInterface::Impl::AddReadInterpreter_Async, _d, call  ) );
+    _d->inline_interpreters_enabled = enable;
 }
 
 } /* namespace CanMoveIt */
@@ -184,7 +184,12 @@ int cmi_loadFile( const char* filename )
     }
 
 
-    std::map<std::string, std::string> can_map;
+    struct CanPortConfig
+    {
+        std::string bitrate;
+        bool        shared_executor;
+    };
+    std::map<std::string, CanPortConfig> can_map;
 
     XMLElement* el_can_ports = getUniqueChild("CanPorts" , &doc);
 
@@ -198,10 +203,21 @@ int cmi_loadFile( const char* filename )
 
         const char* portname  = child->Attribute("portname");
         const char* bitrate   = child->Attribute("bitrate");
+        // optional: executor="shared" makes the port use CMI::async_can instead of its own thread.
+        const char* executor  = child->Attribute("executor");
+
+        if( executor && strcmp(executor, "shared") != 0 && strcmp(executor, "own") != 0 )
+        {
+            Log::SYS()->error("XML: attribute [executor] of <CanPort> must be either \"own\" or \"shared\"");
+            throw std::runtime_error("XML: wrong attribute [executor] in <CanPort>");
+        }
 
         if( portname && bitrate)
         {
-            can_map.insert( std::pair<std::string, std::string>( portname,  bitrate ) );
+            CanPortConfig config;
+            config.bitrate = bitrate;
+            config.shared_executor = ( executor && strcmp(executor, "shared") == 0 );
+            can_map.insert( std::make_pair( std::string(portname),  config ) );
         }
         else{
             Log::SYS()->error("XML: Missing attribute in <CanPort>. Must have [portname] and [bitrate]");
@@ -268,8 +284,8 @@ int cmi_loadFile( const char* filename )
             Log::SYS()->error("XML: can't find in the XML any CanPort with this portname:  ",  can_portname);
             throw std::runtime_error( std::string("XML: can't find in the XML any CanPort with this portname: ") + can_portname);
         }
-        std::string can_bitrate = can_map[can_portname];
-        CANPortPtr  can_port = openCanPort( can_portname.c_str(), can_bitrate.c_str() );
+        const CanPortConfig& can_config = can_map[can_portname];
+        CANPortPtr  can_port = openCanPort( can_portname.c_str(), can_config.bitrate.c_str(), can_config.shared_executor );
 
         //---------------------------------------------------------
         std::string dictionary_name ( getUniqueChild("dictionary_name", device)->GetText() );
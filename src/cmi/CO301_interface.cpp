@@ -91,6 +91,9 @@ int remove_CO301_Interface(uint16_t device_id)
     }
 }
 
+// Maximum number of bytes preallocated for an SDO upload, whatever size is indicated by the slave.
+static const size_t SDO_MAX_RESERVE = 64*1024;
+
 //--------------------------------------------------------------
 class CO301_Interface::Impl
 {
@@ -99,28 +102,156 @@ public:
     {
     public:
         std::vector<ObjectKey>   object;
+        std::vector<uint8_t>     width;  // bytes used by each object in the frame (0: size of the object).
         uint16_t                   cob_id;
+        bool                       cob_id_known; // false if it couldn't be read from the node.
+        bool                       enabled;      // bit 31 (PDO not valid) of the COB-ID is clear.
+
+        PDO_MappingCache(): cob_id(0), cob_id_known(false), enabled(false) {}
     };
 
     std::map<uint16_t,std::shared_ptr<PDO_MappingCache> >  pdo_list;
     typedef std::map<uint16_t,std::shared_ptr<PDO_MappingCache> >::iterator PDO_List_iterator;
 
+    enum{ COB_ID_TABLE_SIZE = 2048 };
+
+    // Flat version of pdo_list used by PDO_Interpreter, rebuilt by compilePdoDecoder
+    // every time the mapping changes.
+    struct PdoField
+    {
+        ObjectKey  key;
+        uint8_t    offset;     // first byte in the frame.
+        uint8_t    width;      // bytes in the frame.
+        uint8_t    size;       // bytes of the object in the database.
+        bool       is_signed;
+    };
+    struct CompiledPdo
+    {
+        uint8_t    first_field;
+        uint8_t    num_fields;
+    };
+    struct PdoDecoder
+    {
+        std::vector<int8_t>       by_cob_id;  // index in pdo, or -1.
+        std::vector<CompiledPdo>  pdo;
+        std::vector<PdoField>     fields;
+        PdoDecoder(): by_cob_id( COB_ID_TABLE_SIZE, -1 ) {}
+    };
+    // The decoder is read without locks; the readers are counted in pdo_decoder_readers.
+    // pdo_decoders.back() is the current decoder, the others are deleted by compilePdoDecoder
+    // as soon as it sees no readers (a reader that comes later loads the current one).
+    Mutex                                       pdo_decoder_mutex;
+    std::atomic<const PdoDecoder*>              pdo_decoder;
+    std::atomic<int>                            pdo_decoder_readers;
+    std::vector< std::unique_ptr<PdoDecoder> >  pdo_decoders;
+
     template <typename T> bool pdoRX_find_and_fill(ObjectID id, const T& value);
 
     uint32_t     msg_sent;
-    uint32_t     bytes_expedited_transfer;
 
     Mutex      wait_mutex;
+    // number of threads inside waitObjectUpdate. When it is zero, the PDOs don't need to lock wait_mutex.
+    std::atomic<int>  object_waiters;
     uint8_t    node_id;
 
     std::deque<CanMessage> _recorded_configuration_msgs;
 
+    // SDO transactions started with sdoReadAsync / sdoWriteAsync, in the order they were queued.
+    // Their requests are sent with CanMessage::tag set: the answers of the other SDO requests
+    // (sdoWrite, sdoObjectRequest) to the same objects don't complete them.
+    struct PendingSdo
+    {
+        uint64_t     id;
+        ObjectKey    key;
+        bool         is_write;
+        Variant      value;
+        SdoCallback  callback;
+    };
+    Mutex                   pending_sdo_mutex;
+    std::deque<PendingSdo>  pending_sdo;
+    uint64_t                pending_sdo_next_id;
+
+    uint64_t addPendingSdo(PendingSdo&& pending)
+    {
+        LockGuard lock( pending_sdo_mutex );
+        pending.id = pending_sdo_next_id++;
+        pending_sdo.push_back( std::move(pending) );
+        return pending_sdo.back().id;
+    }
+
+    // used when the request could not be queued.
+    void removePendingSdo(uint64_t id)
+    {
+        LockGuard lock( pending_sdo_mutex );
+        for( auto it = pending_sdo.begin(); it != pending_sdo.end(); it++ )
+        {
+            if( it->id == id )
+            {
+                pending_sdo.erase( it );
+                return;
+            }
+        }
+    }
+
+    // Segmented SDO transfer in progress. The TX queue waits for the answer of each request,
+    // therefore there is at most one per node. The segments (and their answers) don't contain
+    // index and subindex: the object is remembered here.
+    enum SegmentedState{ SEGMENTED_IDLE, SEGMENTED_UPLOAD, SEGMENTED_DOWNLOAD };
+    struct SegmentedTransfer
+    {
+        SegmentedState        state;
+        ObjectKey             key;
+        std::vector<uint8_t>  buffer;
+        size_t                size;     // upload: size indicated by the slave (0 if not indicated).
+        size_t                offset;   // download: first byte of the next segment.
+        bool                  toggle;
+        bool                  tagged;   // started by sdoReadAsync / sdoWriteAsync.
+        SegmentedTransfer(): state(SEGMENTED_IDLE), size(0), offset(0), toggle(false), tagged(false) {}
+    };
+    Mutex                          segmented_mutex;
+    SegmentedTransfer              segmented;
+    // segmented downloads started by sdoWrite, waiting for the answer of their initiate request.
+    std::deque<SegmentedTransfer>  segmented_downloads;
+
+    // SDO block transfer (at most one per node).
+    enum BlockState{ BLOCK_IDLE,
+                     BLOCK_UPLOAD_INITIATE, BLOCK_UPLOAD_RECEIVING, BLOCK_UPLOAD_END,
+                     BLOCK_DOWNLOAD_INITIATE, BLOCK_DOWNLOAD_SENDING, BLOCK_DOWNLOAD_END };
+    struct BlockTransfer
+    {
+        BlockState            state;
+        ObjectKey             key;
+        std::vector<uint8_t>  buffer;
+        size_t                offset;        // download: first byte of the current block.
+        uint8_t               block_size;
+        uint8_t               last_seqno;    // upload: last segment received in sequence.
+        uint8_t               segments_in_block; // download: segments sent in the current block.
+        bool                  last_sent;     // download: the current block contains the last segment.
+        bool                  use_crc;
+        size_t                expected_size; // upload: size indicated by the slave (0 if unknown).
+        SdoCallback           callback;
+        TimePoint             start_time;
+        BlockTransfer(): state(BLOCK_IDLE), offset(0), block_size(127), last_seqno(0),
+            segments_in_block(0), last_sent(false), use_crc(false), expected_size(0) {}
+    };
+    Mutex                   block_mutex;
+    BlockTransfer           block;
+    uint8_t                 block_size;
+    // SDO requests held back during a block upload (see pushSdoRequest).
+    std::deque<CanMessage>  held_sdo_requests;
+    // inactivity timeout of the block upload (the segments are not requested one by one).
+    AsyncManager::Handle_t  block_alarm;
+
     NMT_OperationalState operational_state;
     ObjectsDictionaryPtr  object_dictionary_ptr;
     ObjectsDatabase       object_database;
 
     Impl(ObjectsDictionaryPtr obj_dict):
-        bytes_expedited_transfer(0),
+        pdo_decoder( nullptr ),
+        pdo_decoder_readers( 0 ),
+        object_waiters( 0 ),
+        pending_sdo_next_id( 0 ),
+        block_size(127),
         operational_state( NMT_STATE_NOT_DEFINED),
         object_dictionary_ptr ( obj_dict ),
         object_database( obj_dict )
@@ -136,18 +267,21 @@ uint8_t  CO301_Interface::node_ID() const { return _d->node_id; }
 
 CO301_Interface::CO301_Interface( CANPortPtr can_port, uint8_t node_id, ObjectsDictionaryPtr obj_dict, uint16_t device_id):
     CanInterface( can_port,device_id, 0,  0),
-    _d( new Impl( obj_dict) )
+    _d( new Impl( obj_dict) ),
+    _database( &_d->object_database )
 {
     Log::CO301()->info("--- creating CO301_Interface for node {} with devide_id {} ----", (int32_t) node_id, (int32_t) device_id );
 
     InterpreterCallback callback =  std::bind(&CO301_Interface::SDO_Interpreter, this, std::placeholders::_1);
     this->addReadInterpreter( callback );
 
-    _d->bytes_expedited_transfer = -1;
     _d->node_id = node_id;
 
+    // PDOs only update the object database: they can be processed by the receive thread.
     callback =  std::bind(&CO301_Interface::PDO_Interpreter, this, std::placeholders::_1);
-    this->addReadInterpreter( callback );
+    this->addReadInterpreter( callback, true );
+
+    _d->block_alarm = this->can_port()->executor()->addAlarm();
 }
 
 void CO301_Interface::rebuildObjectDatabase(ObjectsDictionaryPtr new_dictionary)
@@ -181,10 +315,7 @@ ObjectID CO301_Interface::getObjectID(ObjectKey key )
 
 ObjectKey CO301_Interface::tryFindObjectKey( ObjectID id)
 {
-    try{
-        return findObjectKey(id);
-    }
-    catch(std::runtime_error ) { return ObjectKey(0xFF); }
+    return _d->object_dictionary_ptr->tryFind( id.index(), id.subindex() );
 }
 
 const ObjectEntry& CO301_Interface::getObjectDictionaryEntry (ObjectKey const& key)
@@ -193,6 +324,23 @@ const ObjectEntry& CO301_Interface::getObjectDictionaryEntry (ObjectKey const& k
 }
 
 
+// Wait for the result of sdoReadAsync. The timeout is just a safety net: the transaction is
+// completed by the queue anyway, either with the answer or when the read timeout expires.
+static bool waitSdoResult( std::future<SdoResult>& reply, Microseconds timeout, Variant* value )
+{
+    if( reply.wait_for( timeout ) != std::future_status::ready )
+    {
+        return false;
+    }
+    SdoResult result = reply.get();
+    if( result.status != DS_NEW_DATA )
+    {
+        return false;
+    }
+    *value = result.value;
+    return true;
+}
+
 void CO301_Interface::initPDO(PDO_Id pdo)
 {
     int16_t pdo_map = 0;
@@ -210,55 +358,135 @@ void CO301_Interface::initPDO(PDO_Id pdo)
 
     // get the COB_ID and rewrite it if necessary.
     uint32_t pdo_cob_id = 0;
+    bool     pdo_cob_id_known = false;
     Variant temp(0);
     try{
         ObjectKey pdo_cob_id_key = findObjectKey( pdo_comm, 1);
-        if( sdoRequestAndGet ( pdo_cob_id_key , &temp, Milliseconds(100)) == DS_NEW_DATA)
+        ObjectKey pdo_map_0_key  = tryFindObjectKey( ObjectID( pdo_map, 0) );
+
+        // the requests are queued together, instead of waiting each answer before sending the next request.
+        std::future<SdoResult> cob_id_reply = sdoReadAsync( pdo_cob_id_key );
+        std::future<SdoResult> num_elements_reply;
+        if( pdo_map_0_key != ObjectKey(ObjectsDictionary::NOT_FOUND) )
+        {
+            num_elements_reply = sdoReadAsync( pdo_map_0_key );
+        }
+
+        if( waitSdoResult( cob_id_reply, sdoAnswerTimeout() * 2, &temp ) )
         {
             pdo_cob_id = temp.extract<uint32_t>( );
+            pdo_cob_id_known = true;
         }
 
         uint32_t new_cob_id = (pdo_cob_id & 0xffffFF80) + node_ID();
-        if( new_cob_id != pdo_cob_id)
+        if( pdo_cob_id_known && new_cob_id != pdo_cob_id)
         {
             sdoWrite( pdo_cob_id_key, new_cob_id);
         }
 
         std::shared_ptr<Impl::PDO_MappingCache> mc (new Impl::PDO_MappingCache);
-        mc->cob_id = new_cob_id;
+        mc->cob_id       = new_cob_id;
+        mc->cob_id_known = pdo_cob_id_known;
+        mc->enabled      = pdo_cob_id_known && !( pdo_cob_id & (0x1u << 31) );
         // _d->pdo_list.insert(std::make_pair(pdo_comm, mc) );
         _d->pdo_list[pdo_comm] = mc;
 
+        if( !num_elements_reply.valid() )
+        {
+            throw std::runtime_error("PDO mapping not found in the dictionary");
+        }
+
         // lets take more information
         uint8_t num_elements = 0;
-        if( sdoRequestAndGet( findObjectKey( pdo_map, 0), &temp, Milliseconds(100)) == DS_NEW_DATA)
+        if( waitSdoResult( num_elements_reply, sdoAnswerTimeout() * 2, &temp ) )
         {
             num_elements = temp.extract<uint8_t>( );
         }
 
         mc->object.resize( num_elements );
+        mc->width.resize( num_elements, 0 );
 
+        std::vector< std::future<SdoResult> > mapping_replies;
+        for (uint8_t s=1; s <= num_elements; s++)
+        {
+            mapping_replies.push_back( sdoReadAsync( findObjectKey( pdo_map, s) ) );
+        }
         for (uint8_t s=1; s <= num_elements; s++)
         {
             uint32_t value = 0;
-            if( sdoRequestAndGet( findObjectKey( pdo_map, s), &temp, Milliseconds(100)) == DS_NEW_DATA)
+            if( waitSdoResult( mapping_replies[s-1], sdoAnswerTimeout() * (1 + num_elements), &temp ) )
             {
                 value = temp.extract<uint32_t>( );
             }
             mc->object[s-1] = findObjectKey( 0xFFFF & ( value>>16),  0xFF & ( value>>8));
+            mc->width[s-1]  = ( value & 0xFF ) / 8;
         }
     }
     catch( std::runtime_error &)
     {
         // no problem
     }
+    compilePdoDecoder();
+}
+
+void CO301_Interface::compilePdoDecoder()
+{
+    LockGuard lock( _d->pdo_decoder_mutex );
+
+    std::unique_ptr<Impl::PdoDecoder> decoder( new Impl::PdoDecoder );
+
+    for( auto& it: _d->pdo_list )
+    {
+        const Impl::PDO_MappingCache& mapping = *(it.second);
+        if( !mapping.cob_id_known || !mapping.enabled )
+        {
+            continue; // nothing would be received with this COB-ID.
+        }
+        const uint16_t cob_id = mapping.cob_id & 0x7FF;
+
+        Impl::CompiledPdo pdo;
+        pdo.first_field = static_cast<uint8_t>( decoder->fields.size() );
+        pdo.num_fields  = 0;
+
+        uint8_t offset = 0;
+        for( size_t i = 0; i < mapping.object.size() && offset < 8; i++ )
+        {
+            const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry( mapping.object[i] );
+            const int size = getSize( entry.type() );
+            if( size < 0 )
+            {
+                Log::CO301()->error("node {}: object 0x{:X}/0x{:X} can't be mapped to a PDO",
+                                    (int)node_ID(), entry.index(), entry.subindex() );
+                break;
+            }
+            Impl::PdoField field;
+            field.key       = mapping.object[i];
+            field.offset    = offset;
+            field.size      = static_cast<uint8_t>( size );
+            field.width     = ( i < mapping.width.size() && mapping.width[i] != 0 ) ? mapping.width[i] : field.size;
+            field.width     = std::min( field.width, field.size );
+            field.is_signed = isSigned( entry.type() ) && entry.type() != FLOAT32 && entry.type() != FLOAT64;
+            decoder->fields.push_back( field );
+            pdo.num_fields++;
+            offset += field.width;
+        }
+        decoder->by_cob_id[cob_id] = static_cast<int8_t>( decoder->pdo.size() );
+        decoder->pdo.push_back( pdo );
+    }
+
+    _d->pdo_decoder.store( decoder.get() );
+    _d->pdo_decoders.push_back( std::move(decoder) );
 
+    if( _d->pdo_decoder_readers.load() == 0 )
+    {
+        _d->pdo_decoders.erase( _d->pdo_decoders.begin(), _d->pdo_decoders.end() - 1 );
+    }
 }
 
 bool CO301_Interface::init()
 {
     Variant device_type = 0;
-    sdoRequestAndGet( findObjectKey( 0x1000, 0), &device_type, Milliseconds(100));
+    sdoRequestAndGet( findObjectKey( 0x1000, 0), &device_type, sdoAnswerTimeout());
     if( device_type == 0)
     {
         throw std::runtime_error("Cant communicate with drive");
@@ -286,6 +514,11 @@ NMT_OperationalState CO301_Interface::getOperationalState()
 }
 
 void CO301_Interface::sdoObjectRequest(const ObjectKey & key)
+{
+    sdoObjectRequest( key, false );
+}
+
+void CO301_Interface::sdoObjectRequest(const ObjectKey & key, bool tagged)
 {
     const ObjectEntry& entry  = _d->object_dictionary_ptr->getEntry(key);
     ObjectData&  data         = _d->object_database.getData(key);
@@ -310,7 +543,8 @@ void CO301_Interface::sdoObjectRequest(const ObjectKey & key)
     msg.data[7] = 0;
     msg.wait_answer = NEED_TO_WAIT_ANSWER;
     msg.desired_answer = SDO_TX + node_ID();
-    pushMessage(msg);
+    msg.tag = tagged;
+    pushSdoRequest(msg);
 }
 
 
@@ -386,6 +620,7 @@ void CO301_Interface::pdoMapping(PDO_Id pdo, PDO_MappingList& mapping_list , uin
 
     //STEP 3: map the objects
     _d->pdo_list[pdo_comm]->object.resize( mapping_list.size() );
+    _d->pdo_list[pdo_comm]->width.assign( mapping_list.size(), 0 );
 
     for (int i=0; i< mapping_list.size(); i++)
     {
@@ -401,7 +636,13 @@ void CO301_Interface::pdoMapping(PDO_Id pdo, PDO_MappingList& mapping_list , uin
     sdoWrite( pdo_map_0 , mapping_list.size());
     cobid = _d->pdo_list[pdo_comm]->cob_id;
     sdoWrite( pdo_comm_1 ,  cobid  );
+    if( new_cobid != 0 )
+    {
+        _d->pdo_list[pdo_comm]->cob_id_known = true;
+    }
+    _d->pdo_list[pdo_comm]->enabled = true;
 
+    compilePdoDecoder();
 }
 
 void CO301_Interface::pdoEnableComm(PDO_Id pdo, bool enable)
@@ -429,6 +670,12 @@ void CO301_Interface::pdoEnableComm(PDO_Id pdo, bool enable)
         new_cob_id |= (0x1 << 31) ;
     }
     sdoWrite( findObjectKey( pdo_comm,1) ,new_cob_id );
+
+    if( _d->pdo_list[pdo_comm]->enabled != enable )
+    {
+        _d->pdo_list[pdo_comm]->enabled = enable;
+        compilePdoDecoder();
+    }
 }
 
 
@@ -498,7 +745,7 @@ void  CO301_Interface::push_PDO_RX(PDO_Id pdo, uint8_t msg_size, uint8_t* data)
     msg.cob_id = _d->pdo_list[pdo_comm]->cob_id;
     msg.len = msg_size;
     memcpy( msg.data, data, msg_size);
-    pushMessage( msg );
+    pushMessage( msg, TX_LANE_REALTIME );
 }
 
 
@@ -508,9 +755,10 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
 
     if (m.getNode() != _d->node_id) { return false;}
 
-    static uint8_t expedited_data[256];
-    static int expedited_data_size = 0;
-    static ObjectKey expedited_key;
+    if( m.getCOB() == SDO_TX && SDO_BlockInterpreter( m ) )
+    {
+        return true;
+    }
 
     uint16_t COB = m.getCOB();
     TimePoint msg_tp = TimePoint() + Microseconds(m.timestamp_usec);
@@ -523,6 +771,11 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
         uint8_t scs = (res >> 5) & 0x7;
         uint8_t expedited_flag = (res >> 1) & 0x1;
 
+        // the answers of the segments don't contain index and subindex.
+        if( SDO_SegmentedInterpreter( m ) )
+        {
+            break;
+        }
 
         uint16_t index = ((m.data[2]<<8) & 0xFF00) +  m.data[1];
         uint8_t  subindex = m.data[3];
@@ -531,6 +784,7 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
         if(scs == 4) // Abort SDO Transfer
         {
             uint32_t error_code =  m.data[4] + (m.data[5]<<8) +  (m.data[6]<<16) +  (m.data[7]<<24);
+            cancelSegmentedTransfer( key );
 
             EventData event;
             event.event_id   = EVENT_ERROR_IN_PROTOCOL;
@@ -538,6 +792,8 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
             event.timestamp  = GetTimeNow();
             events()->push_event( this->device_ID(), event );
 
+            completeSdo( getLastMsgSent().tag, key, SDO_ABORTED, error_code, msg_tp );
+
             Log::CO301()->error("--error in the answer of the SDO: index [0x{:X}] subindex [0x{:X}]: {}\n",
                                 (int)index ,  (int)subindex, m);
             std::string e;
@@ -574,55 +830,13 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
         { // it was a DOWNLOAD. everything ok. nothing to do
             //your command has been accepted: store the value locally WITHOUT a callback
             receivedNewObject( key, & ( this->getLastMsgSent().data[4]), msg_tp );
+            completeSdo( getLastMsgSent().tag, key, SDO_DOWNLOAD_DONE, 0, msg_tp );
         }
-        else if( scs == 2 && expedited_flag) // UPLOAD Segment SDO
+        else if( scs == 2 && expedited_flag) // Expedited upload
         {  // it is the answer of an UPLOAD!!
             //your command has been accepted: store the value locally WITH a callback.
             receivedNewObject( key, &(m.data[4]), msg_tp );
-        }
-        else if( scs== 0) // Initiate SDO Upload
-        {	//initiate upload
-            int reply_size = m.data[4];
-            _d->bytes_expedited_transfer = reply_size;
-
-            bool toggle = 0;
-            CanMessage msg_out;
-            msg_out.cob_id = SDO_RX + node_ID();
-            msg_out.len = 8;
-            msg_out.wait_answer  = NEED_TO_WAIT_ANSWER;
-            msg_out.desired_answer = SDO_TX + node_ID();
-
-            int req_num = reply_size / 7;
-            if(reply_size > req_num*7) req_num += 1;
-
-            toggle = (bool)(req_num%2);
-
-            for (int i=0; i<req_num; i++)
-            {
-                if (toggle==1)   msg_out.data[0] = 0x60 ;
-                else			  msg_out.data[0] = 0x70 ;
-                toggle = !toggle;
-                pushMessage(msg_out, true);
-            }
-            expedited_data_size = 0;
-            expedited_key = _d->object_dictionary_ptr->find(index,subindex);
-        }
-        else if( _d->bytes_expedited_transfer > 0 )
-        {
-            int received_here = m.data[0] & 0x0F;
-            if( received_here == 0) received_here = 7;
-            for (int i=0; i<received_here; i++ )
-            {
-                expedited_data[ expedited_data_size + i] = m.data[1+i];
-            }
-            expedited_data_size += received_here;
-            _d->bytes_expedited_transfer -= received_here;
-
-            if( _d->bytes_expedited_transfer <=0 )
-            {
-                expedited_data[expedited_data_size] = '\0';
-                receivedNewObject( expedited_key , expedited_data, msg_tp );
-            }
+            completeSdo( getLastMsgSent().tag, key, SDO_UPLOAD_DONE, 0, msg_tp );
         }
         else{
             Log::CO301()->error("SDO_TX... what is this? 0x{:X}\n{}", res, m);
@@ -669,34 +883,103 @@ bool CO301_Interface::SDO_Interpreter(const CanMessage & m)
     return recognized;
 }
 
+// Counts the readers of the PDO decoder, see CO301_Interface::Impl::pdo_decoders.
+struct PdoDecoderReader
+{
+    std::atomic<int>& readers;
+    explicit PdoDecoderReader(std::atomic<int>& r): readers(r) { readers.fetch_add( 1 ); }
+    ~PdoDecoderReader() { readers.fetch_sub( 1, std::memory_order_release ); }
+};
+
 bool CO301_Interface::PDO_Interpreter(const CanMessage & m)
 {
-    bool recognized = false;
-    std::shared_ptr< Impl::PDO_MappingCache> pdo_mapped;
+    PdoDecoderReader reader( _d->pdo_decoder_readers );
+    const Impl::PdoDecoder* decoder = _d->pdo_decoder.load();
+    if( !decoder || m.cob_id >= Impl::COB_ID_TABLE_SIZE )
+    {
+        return false;
+    }
+    const int8_t index = decoder->by_cob_id[ m.cob_id ];
+    if( index < 0 )
+    {
+        return false;
+    }
 
-    for ( Impl::PDO_List_iterator it = _d->pdo_list.begin(); it != _d->pdo_list.end(); it++)
+    const Impl::CompiledPdo& pdo = decoder->pdo[index];
+    const TimePoint tp = TimePoint() + Microseconds(m.timestamp_usec);
+
+    // everything on the stack: the steady-state reception of the PDOs doesn't allocate.
+    ObjectKey       keys[8];
+    const uint8_t*  values[8];
+    uint8_t         extended[8][8];
+    uint8_t         count = 0;
+
+    for( uint8_t i = 0; i < pdo.num_fields && count < 8; i++ )
     {
-        if( it->second->cob_id == m.cob_id )
+        const Impl::PdoField& field = decoder->fields[ pdo.first_field + i ];
+        if( field.offset + field.width > m.len )
         {
-            pdo_mapped = it->second;
-            break;
+            break; // frame shorter than the mapping
         }
+        keys[count] = field.key;
+        if( field.width == field.size )
+        {
+            values[count] = &m.data[field.offset];
+        }
+        else{
+            // mapped with fewer bits than the object: extend the value.
+            const bool negative = field.is_signed && ( m.data[field.offset + field.width - 1] & 0x80 );
+            memset( extended[count], negative ? 0xFF : 0x00, 8 );
+            memcpy( extended[count], &m.data[field.offset], field.width );
+            values[count] = extended[count];
+        }
+        count++;
     }
 
-    if( pdo_mapped )
-    {
-        recognized = true;
-        int array_offset=0;
+    _d->object_database.setValuesFromBytes( keys, values, count, tp );
+    notifyObjectsUpdated( m.cob_id, keys, count, tp );
+    return true;
+}
 
-        for(unsigned i=0; i< pdo_mapped->object.size(); i++)
+void CO301_Interface::notifyObjectsUpdated(uint16_t cob_id, const ObjectKey* keys, uint8_t count, TimePoint timestamp)
+{
+    EventDispatcher* dispatcher = this->events();
+
+    // the events are built only if somebody subscribed to them (absl::any allocates).
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry( keys[i] );
+        if( dispatcher->hasSubscribers( entry.id().get() ) )
         {
-            ObjectKey key = pdo_mapped->object[i];
-            TimePoint tp = TimePoint() + Microseconds(m.timestamp_usec);
-            int size_obj = receivedNewObject(key,  &(m.data[array_offset]) , tp );
-            array_offset += size_obj;
+            EventData event;
+            event.timestamp = timestamp;
+            event.info      = EventDataObjectUpdated( entry, _d->object_database.getData( keys[i] ) );
+            event.event_id  = entry.id().get();
+            dispatcher->push_event( device_ID(), event );
         }
     }
-    return recognized;
+    if( dispatcher->hasSubscribers( EVENT_PDO_RECEIVED ) )
+    {
+        EventDataPdoReceived pdo;
+        pdo.cob_id   = cob_id;
+        pdo.num_keys = count;
+        std::copy( keys, keys + count, pdo.keys );
+
+        EventData event;
+        event.timestamp = timestamp;
+        event.info      = pdo;
+        event.event_id  = EVENT_PDO_RECEIVED;
+        dispatcher->push_event( device_ID(), event );
+    }
+
+    // wake up waitObjectUpdate (the conditions of absl::Mutex are evaluated when it is unlocked).
+    // The fence pairs with the increment of object_waiters: either the waiter sees the new value
+    // or we see the waiter.
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( _d->object_waiters.load() > 0 )
+    {
+        LockGuard lock( _d->wait_mutex );
+    }
 }
 
 int CO301_Interface::receivedNewObject(ObjectKey const& key, const uint8_t * data, TimePoint timestamp)
@@ -709,16 +992,18 @@ int CO301_Interface::receivedNewObject(ObjectKey const& key, const uint8_t * dat
         // update the value inside the local storage
         i = _d->object_database.setValueFromBytes(key, data, timestamp );
 
-        EventData event;
-        event.timestamp = timestamp;
-
         const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
-        event.info = EventDataObjectUpdated( entry, _d->object_database.getData(key) );
-        event.event_id = entry.id().get();
+        if( this->events()->hasSubscribers( entry.id().get() ) )
+        {
+            EventData event;
+            event.timestamp = timestamp;
+            event.info = EventDataObjectUpdated( entry, _d->object_database.getData(key) );
+            event.event_id = entry.id().get();
 
-        // push event related to this object.
-        // To be done before broadcast otherwise some functions will not work properly
-        this->events()->push_event(device_ID(), event );
+            // push event related to this object.
+            // To be done before broadcast otherwise some functions will not work properly
+            this->events()->push_event(device_ID(), event );
+        }
     }
 
     return i;
@@ -728,12 +1013,23 @@ void CO301_Interface::sendSync ()
 {
     CanMessage msg;
     msg.cob_id = SYNC;
-    this->pushMessage( msg );
+    this->pushMessage( msg, TX_LANE_REALTIME );
 }
 
 ObjectsDictionaryPtr CO301_Interface::getObjectDictionary() { return _d->object_dictionary_ptr; }
 
+template <typename T> static void appendBytes(std::vector<uint8_t>* data, T value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>( &value );
+    data->insert( data->end(), bytes, bytes + sizeof(T) );
+}
+
 void CO301_Interface::sdoWrite(const ObjectKey & key, const Variant& value )
+{
+    sdoWrite( key, value, false );
+}
+
+void CO301_Interface::sdoWrite(const ObjectKey & key, const Variant& value, bool tagged )
 {
     const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
 
@@ -748,6 +1044,55 @@ void CO301_Interface::sdoWrite(const ObjectKey & key, const Variant& value )
                              entry.index(), entry.subindex() );
         return;
     }
+
+    const int size = getSize( entry.type() );
+    if( size < 0 )
+    {
+        // STRING or domain: the raw content of the string is sent.
+        const std::string str = value.convert<std::string>();
+        sdoWriteSegmented( key, std::vector<uint8_t>( str.begin(), str.end() ), tagged );
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    switch( entry.type() )
+    {
+    case UINT64:  appendBytes( &data, value.convert<uint64_t>() ); break;
+    case INT64:   appendBytes( &data, value.convert<int64_t>() );  break;
+    case FLOAT64: appendBytes( &data, value.convert<double>() );   break;
+    default:{
+        uint32_t vi = 0;
+        if( isSigned( entry.type() ) )
+        {
+            int32_t temp = value.convert<int32_t>();
+            vi = static_cast<uint32_t>(temp);
+        }
+        else{
+            vi = value.convert<uint32_t>();
+        }
+        appendBytes( &data, vi );
+    }
+    }
+    sdoWriteBytes( key, data.data(), size, tagged );
+}
+
+void CO301_Interface::sdoWriteBytes(ObjectKey const& key, const uint8_t* bytes, uint8_t size, bool tagged)
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+
+    if( entry.access_type() == ObjectEntry::RO || entry.access_type() == ObjectEntry::CNST)
+    {
+        Log::CO301()->error("object 0x{:X} / 0x{:X} can't be written. Check the access type in the dictionary.",
+                             entry.index(), entry.subindex() );
+        return;
+    }
+
+    if( size > 4 )
+    {
+        sdoWriteSegmented( key, std::vector<uint8_t>( bytes, bytes + size ), tagged );
+        return;
+    }
+
     CanMessage msg;
     const uint8_t CCS = 1<<5;
     const uint8_t expedited = 1<<1;
@@ -758,28 +1103,18 @@ void CO301_Interface::sdoWrite(const ObjectKey & key, const Variant& value )
     msg.wait_answer  = NEED_TO_WAIT_ANSWER;
     msg.desired_answer = SDO_TX + node_ID();
 
-    msg.data[0]= CCS | ((4 - entry.size() )<<2) | expedited | indicated;
+    msg.data[0]= CCS | ((4 - size )<<2) | expedited | indicated;
     msg.data[1]= entry.index() & 0x00FF;
     msg.data[2]= (entry.index() >> 8)& 0x00FF;
     msg.data[3]= entry.subindex();
 
-    uint32_t vi = 0;
-
-    if( isSigned( entry.type() ) )
+    for( uint8_t i = 0; i < 4; i++ )
     {
-        int32_t temp = value.convert<int32_t>();
-        vi = static_cast<uint32_t>(temp);
-    }
-    else{
-        vi = value.convert<uint32_t>();
+        msg.data[4+i] = ( i < size ) ? bytes[i] : 0;
     }
+    msg.tag = tagged;
 
-    msg.data[4] =  vi & 0x00FF;
-    msg.data[5] = (vi >>  8) & 0x00FF;
-    msg.data[6] = (vi >>  16) & 0x00FF;
-    msg.data[7] = (vi >>  24) & 0x00FF;
-
-    pushMessage(msg);
+    pushSdoRequest(msg);
 }
 
 void CO301_Interface::setHeartbeatProducerPeriod( Milliseconds ms)
@@ -810,10 +1145,14 @@ bool CO301_Interface::waitObjectUpdate(ObjectKey const& key, Microseconds timeou
 
         absl::Condition object_updated( +[](ObjectData* obj)
         {
-            return obj->get_isnew() != DS_NEW_DATA;
+            return obj->get_isnew() == DS_NEW_DATA;
         }, &obj );
 
+        // Await must be called with the mutex locked.
+        LockGuard lock( _d->wait_mutex );
+        _d->object_waiters++;
         bool done = _d->wait_mutex.AwaitWithDeadline( object_updated, absl::FromChrono(deadline) );
+        _d->object_waiters--;
         return done;
     }
     return true; //return true if condition has been signaled or it was already NEW_DATA
@@ -849,6 +1188,858 @@ DataStatus CO301_Interface::sdoRequestAndGet( ObjectKey  const& key,
     return getLastObjectReceived ((key), value);
 }
 
-} // namespace CanMoveIt */
+void CO301_Interface::sdoReadAsync( ObjectKey const& key, SdoCallback callback )
+{
+    // queued before the request, otherwise the answer might arrive first.
+    Impl::PendingSdo pending;
+    pending.key      = key;
+    pending.is_write = false;
+    pending.callback = callback;
+    const uint64_t id = _d->addPendingSdo( std::move(pending) );
+    try{
+        sdoObjectRequest( key, true );
+    }
+    catch( ... )
+    {
+        _d->removePendingSdo( id );
+        throw;
+    }
+}
+
+std::future<SdoResult> CO301_Interface::sdoReadAsync( ObjectKey const& key )
+{
+    auto promise = std::make_shared< std::promise<SdoResult> >();
+    sdoReadAsync( key, [promise](const SdoResult& result) { promise->set_value( result ); } );
+    return promise->get_future();
+}
 
+void CO301_Interface::sdoWriteAsync( ObjectKey const& key, Variant const& value, SdoCallback callback )
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    if( entry.access_type() == ObjectEntry::RO || entry.access_type() == ObjectEntry::CNST)
+    {
+        // refused locally, with the same abort code the slave would use.
+        SdoResult result;
+        result.key        = key;
+        result.abort_code = 0x06010002;
+        result.value      = value;
+        callback( result );
+        return;
+    }
+    Impl::PendingSdo pending;
+    pending.key      = key;
+    pending.is_write = true;
+    pending.value    = value;
+    pending.callback = callback;
+    const uint64_t id = _d->addPendingSdo( std::move(pending) );
+    try{
+        sdoWrite( key, value, true );
+    }
+    catch( ... ) // for instance, value can't be converted to the type of the object.
+    {
+        _d->removePendingSdo( id );
+        throw;
+    }
+}
+
+std::future<SdoResult> CO301_Interface::sdoWriteAsync( ObjectKey const& key, Variant const& value )
+{
+    auto promise = std::make_shared< std::promise<SdoResult> >();
+    sdoWriteAsync( key, value, [promise](const SdoResult& result) { promise->set_value( result ); } );
+    return promise->get_future();
+}
+
+void CO301_Interface::completeSdo(bool tagged, ObjectKey const& key, SdoAnswerType answer, uint32_t abort_code, TimePoint answer_time)
+{
+    // the answer of a request that wasn't sent by sdoReadAsync or sdoWriteAsync.
+    if( !tagged ) return;
+
+    Impl::PendingSdo pending;
+    {
+        LockGuard lock( _d->pending_sdo_mutex );
+        auto it = _d->pending_sdo.begin();
+        for( ; it != _d->pending_sdo.end(); it++ )
+        {
+            if( it->key != key ) continue;
+            if( answer == SDO_UPLOAD_DONE   &&  it->is_write ) continue;
+            if( answer == SDO_DOWNLOAD_DONE && !it->is_write ) continue;
+            break;
+        }
+        if( it == _d->pending_sdo.end() ) return;
+
+        pending = *it;
+        _d->pending_sdo.erase( it );
+    }
+
+    SdoResult result;
+    result.key        = key;
+    result.abort_code = abort_code;
+    result.value      = pending.value;
+    if( answer_time >= getLastMsgSentTime() )
+    {
+        result.rtt = std::chrono::duration_cast<Microseconds>( answer_time - getLastMsgSentTime() );
+    }
+
+    switch( answer )
+    {
+    case SDO_UPLOAD_DONE:
+        result.status = DS_NEW_DATA;
+        _d->object_database.getValue( key, &result.value );
+        break;
+    case SDO_DOWNLOAD_DONE: result.status = DS_NEW_DATA; break;
+    case SDO_ABORTED:       result.status = DS_NO_DATA;  break;
+    case SDO_EXPIRED:       result.status = DS_TIMEOUT;  break;
+    }
+    pending.callback( result );
+}
+
+void CO301_Interface::answerTimeout(const CanMessage & request)
+{
+    if( request.cob_id != SDO_RX + node_ID() ) return;
+
+    const uint8_t ccs = (request.data[0] >> 5) & 0x7;
+
+    // the requests of the block transfer are the commands with ccs = 5 (upload) or 6 (download)
+    // and the segments sent during a block download. Any other request was queued before the block.
+    bool block_request;
+    {
+        LockGuard lock( _d->block_mutex );
+        block_request = ( _d->block.state != Impl::BLOCK_IDLE ) &&
+                        ( ccs == 5 || ccs == 6 || _d->block.state == Impl::BLOCK_DOWNLOAD_SENDING );
+    }
+    if( block_request )
+    {
+        abortBlockTransfer( 0x05040000 ); // SDO protocol timed out
+        finishBlockTransfer( DS_TIMEOUT, 0, TimePoint() );
+        return;
+    }
 
+    if( ccs == 0 || ccs == 3 ) // Download or upload SDO segment
+    {
+        ObjectKey key;
+        {
+            LockGuard lock( _d->segmented_mutex );
+            if( _d->segmented.state == Impl::SEGMENTED_IDLE ) return;
+            key = _d->segmented.key;
+            _d->segmented = Impl::SegmentedTransfer();
+        }
+        // otherwise the slave would still be in the middle of the transfer.
+        abortSegmentedTransfer( key, 0x05040000 ); // SDO protocol timed out
+        completeSdo( request.tag, key, SDO_EXPIRED, 0, TimePoint() );
+        return;
+    }
+    uint16_t index = ((request.data[2]<<8) & 0xFF00) +  request.data[1];
+    uint8_t  subindex = request.data[3];
+    try{
+        const ObjectKey key = _d->object_dictionary_ptr->find(index, subindex);
+        if( cancelSegmentedTransfer( key ) )
+        {
+            abortSegmentedTransfer( key, 0x05040000 ); // SDO protocol timed out
+        }
+        completeSdo( request.tag, key, SDO_EXPIRED, 0, TimePoint() );
+    }
+    catch( std::runtime_error& ) {}
+}
+
+//--------------------------------------------------------------
+// SDO segmented download
+
+void CO301_Interface::sdoWriteSegmented(ObjectKey const& key, std::vector<uint8_t>&& data, bool tagged)
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    const uint32_t size = static_cast<uint32_t>( data.size() );
+    {
+        LockGuard lock( _d->segmented_mutex );
+        Impl::SegmentedTransfer download;
+        download.state  = Impl::SEGMENTED_DOWNLOAD;
+        download.key    = key;
+        download.buffer = std::move(data);
+        download.size   = size;
+        download.tagged = tagged;
+        _d->segmented_downloads.push_back( std::move(download) );
+    }
+
+    // ccs = 1, e = 0, s = 1: initiate download, size indicated.
+    CanMessage msg;
+    msg.cob_id = SDO_RX + node_ID();
+    msg.len = 8;
+    msg.wait_answer  = NEED_TO_WAIT_ANSWER;
+    msg.desired_answer = SDO_TX + node_ID();
+    msg.data[0]= (1<<5) | 1;
+    msg.data[1]= entry.index() & 0x00FF;
+    msg.data[2]= (entry.index() >> 8)& 0x00FF;
+    msg.data[3]= entry.subindex();
+    msg.data[4] =  size & 0x00FF;
+    msg.data[5] = (size >>  8) & 0x00FF;
+    msg.data[6] = (size >> 16) & 0x00FF;
+    msg.data[7] = (size >> 24) & 0x00FF;
+    msg.tag = tagged;
+    pushSdoRequest(msg);
+}
+
+// To be called with segmented_mutex locked. The request is pushed in front of the queue,
+// so that it is the next message sent, before any other request to this node.
+void CO301_Interface::pushSegmentRequest()
+{
+    Impl::SegmentedTransfer& transfer = _d->segmented;
+
+    CanMessage msg;
+    msg.cob_id = SDO_RX + node_ID();
+    msg.len = 8;
+    msg.wait_answer  = NEED_TO_WAIT_ANSWER;
+    msg.desired_answer = SDO_TX + node_ID();
+    msg.tag = transfer.tagged;
+    memset( msg.data, 0, 8 );
+
+    const uint8_t toggle = transfer.toggle ? 0x10 : 0;
+
+    if( transfer.state == Impl::SEGMENTED_UPLOAD )
+    {
+        // ccs = 3: upload segment request.
+        msg.data[0] = (3<<5) | toggle;
+    }
+    else{
+        const size_t bytes = std::min( static_cast<size_t>(7), transfer.buffer.size() - transfer.offset );
+        const bool   last  = ( transfer.offset + bytes >= transfer.buffer.size() );
+        // ccs = 0, n = bytes without data, c = last segment.
+        msg.data[0] = toggle | ((7 - bytes) << 1) | (last ? 1 : 0);
+        if( bytes > 0 )
+        {
+            memcpy( &msg.data[1], &transfer.buffer[transfer.offset], bytes );
+        }
+        transfer.offset += bytes;
+    }
+    pushMessage( msg, true );
+}
+
+// Forget the segmented transfer of this object (aborted or expired before it was completed).
+// Returns false if there wasn't any.
+bool CO301_Interface::cancelSegmentedTransfer(ObjectKey const& key)
+{
+    bool cancelled = false;
+    LockGuard lock( _d->segmented_mutex );
+    if( _d->segmented.state != Impl::SEGMENTED_IDLE && _d->segmented.key == key )
+    {
+        _d->segmented = Impl::SegmentedTransfer();
+        cancelled = true;
+    }
+    if( !_d->segmented_downloads.empty() && _d->segmented_downloads.front().key == key )
+    {
+        _d->segmented_downloads.pop_front();
+        cancelled = true;
+    }
+    return cancelled;
+}
+
+// Abort SDO transfer request, sent before any other request to this node.
+void CO301_Interface::abortSegmentedTransfer(ObjectKey const& key, uint32_t abort_code)
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry( key );
+    CanMessage msg;
+    msg.cob_id = SDO_RX + node_ID();
+    msg.len = 8;
+    msg.wait_answer = NO_WAIT;
+    msg.data[0] = 0x80;
+    msg.data[1] = entry.index() & 0x00FF;
+    msg.data[2] = (entry.index() >> 8)& 0x00FF;
+    msg.data[3] = entry.subindex();
+    msg.data[4] = abort_code & 0xFF;
+    msg.data[5] = (abort_code >>  8) & 0xFF;
+    msg.data[6] = (abort_code >> 16) & 0xFF;
+    msg.data[7] = (abort_code >> 24) & 0xFF;
+    pushMessage( msg, true );
+}
+
+// Returns true if the message was consumed by the segmented transfer state machine.
+bool CO301_Interface::SDO_SegmentedInterpreter(const CanMessage & m)
+{
+    const uint8_t  command = m.data[0];
+    const uint8_t  scs     = (command >> 5) & 0x7;
+    const uint16_t index   = ((m.data[2]<<8) & 0xFF00) +  m.data[1];
+    const uint8_t  subindex = m.data[3];
+    const TimePoint msg_tp = TimePoint() + Microseconds(m.timestamp_usec);
+
+    Impl::SegmentedTransfer done;
+    uint32_t abort_code = 0;
+    {
+        LockGuard lock( _d->segmented_mutex );
+        Impl::SegmentedTransfer& transfer = _d->segmented;
+
+        switch( transfer.state )
+        {
+        case Impl::SEGMENTED_IDLE:
+        {
+            if( scs == 2 && (command & 0x02) == 0 ) // Initiate upload response, not expedited
+            {
+                transfer = Impl::SegmentedTransfer();
+                transfer.state = Impl::SEGMENTED_UPLOAD;
+                transfer.key   = _d->object_dictionary_ptr->find( index, subindex );
+                transfer.tagged = getLastMsgSent().tag;
+                if( command & 0x01 ) // size indicated
+                {
+                    transfer.size = m.data[4] + (m.data[5]<<8) + (m.data[6]<<16) + (static_cast<uint32_t>(m.data[7])<<24);
+                    // a bogus size must not allocate gigabytes: the rest is allocated as the segments arrive.
+                    transfer.buffer.reserve( std::min( transfer.size, SDO_MAX_RESERVE ) );
+                }
+                pushSegmentRequest();
+                return true;
+            }
+            if( scs == 3 && !_d->segmented_downloads.empty() ) // Initiate download response
+            {
+                const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry( _d->segmented_downloads.front().key );
+                if( entry.index() != index || entry.subindex() != subindex )
+                {
+                    return false; // answer of an expedited download
+                }
+                transfer = std::move( _d->segmented_downloads.front() );
+                _d->segmented_downloads.pop_front();
+                pushSegmentRequest();
+                return true;
+            }
+            return false;
+        }
+
+        case Impl::SEGMENTED_UPLOAD:
+        {
+            if( scs != 0 ) return false;
+            if( ((command & 0x10) != 0) != transfer.toggle )
+            {
+                abort_code = 0x05030000; // toggle bit not alternated
+                break;
+            }
+            const size_t bytes = 7 - ((command >> 1) & 0x7);
+            transfer.buffer.insert( transfer.buffer.end(), &m.data[1], &m.data[1 + bytes] );
+
+            if( (command & 0x01) == 0 ) // more segments
+            {
+                transfer.toggle = !transfer.toggle;
+                pushSegmentRequest();
+                return true;
+            }
+            if( transfer.size != 0 && transfer.size != transfer.buffer.size() )
+            {
+                abort_code = 0x06070010; // length of service parameter does not match
+            }
+        }break;
+
+        case Impl::SEGMENTED_DOWNLOAD:
+        {
+            if( scs != 1 ) return false;
+            if( ((command & 0x10) != 0) != transfer.toggle )
+            {
+                abort_code = 0x05030000; // toggle bit not alternated
+                break;
+            }
+            if( transfer.offset < transfer.buffer.size() )
+            {
+                transfer.toggle = !transfer.toggle;
+                pushSegmentRequest();
+                return true;
+            }
+        }break;
+        }
+
+        done = std::move( transfer );
+        transfer = Impl::SegmentedTransfer();
+    }
+
+    if( abort_code != 0 )
+    {
+        const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry( done.key );
+        abortSegmentedTransfer( done.key, abort_code );
+
+        Log::CO301()->error("node {}: segmented SDO transfer of 0x{:X}/0x{:X} aborted with code 0x{:X}",
+                            (int)node_ID(), entry.index(), entry.subindex(), abort_code );
+        completeSdo( done.tagged, done.key, SDO_ABORTED, abort_code, msg_tp );
+    }
+    else{
+        // store the value locally (with a callback, like the expedited transfers).
+        receivedNewBuffer( done.key, done.buffer.data(), done.buffer.size(), msg_tp );
+        completeSdo( done.tagged, done.key,
+                     done.state == Impl::SEGMENTED_UPLOAD ? SDO_UPLOAD_DONE : SDO_DOWNLOAD_DONE,
+                     0, msg_tp );
+    }
+    return true;
+}
+
+// Shared by the callbacks of the transactions of sdoReadMany / sdoWriteMany and the waiting thread
+// (the latter might return before all the callbacks are invoked).
+struct CO301_Interface::SdoBatch
+{
+    Mutex                   mutex;
+    int                     remaining;
+    std::vector<SdoResult>  results;
+
+    SdoCallback completion(size_t index, std::shared_ptr<SdoBatch> self)
+    {
+        return [index, self](const SdoResult& result)
+        {
+            LockGuard lock( self->mutex );
+            self->results[index] = result;
+            self->remaining--;
+        };
+    }
+};
+
+int CO301_Interface::waitSdoBatch( std::shared_ptr<SdoBatch> batch, std::vector<SdoResult>* results, Microseconds timeout )
+{
+    LockGuard lock( batch->mutex );
+    absl::Condition all_done( +[](SdoBatch* b) { return b->remaining == 0; }, batch.get() );
+    batch->mutex.AwaitWithTimeout( all_done, absl::FromChrono( timeout ) );
+
+    *results = batch->results;
+    int num_ok = 0;
+    for( SdoResult& result: *results )
+    {
+        if( result.status == DS_NEW_DATA ) num_ok++;
+    }
+    return num_ok;
+}
+
+int CO301_Interface::sdoReadMany( std::vector<ObjectKey> const& keys, std::vector<SdoResult>* results, Microseconds timeout )
+{
+    if( isCanReadThread() )
+    {
+        throw std::runtime_error("You CAN NOT use sdoReadMany inside msgReceivedCallback. It would cause an infinite wait" );
+    }
+    auto batch = std::make_shared<SdoBatch>();
+    batch->remaining = keys.size();
+    batch->results.resize( keys.size() );
+    for( size_t i = 0; i < keys.size(); i++ )
+    {
+        batch->results[i].key    = keys[i];
+        batch->results[i].status = DS_TIMEOUT;
+    }
+    for( size_t i = 0; i < keys.size(); i++ )
+    {
+        sdoReadAsync( keys[i], batch->completion( i, batch ) );
+    }
+    return waitSdoBatch( batch, results, timeout );
+}
+
+int CO301_Interface::sdoWriteMany( std::vector< std::pair<ObjectKey, Variant> > const& values, std::vector<SdoResult>* results, Microseconds timeout )
+{
+    if( isCanReadThread() )
+    {
+        throw std::runtime_error("You CAN NOT use sdoWriteMany inside msgReceivedCallback. It would cause an infinite wait" );
+    }
+    auto batch = std::make_shared<SdoBatch>();
+    batch->remaining = values.size();
+    batch->results.resize( values.size() );
+    for( size_t i = 0; i < values.size(); i++ )
+    {
+        batch->results[i].key    = values[i].first;
+        batch->results[i].value  = values[i].second;
+        batch->results[i].status = DS_TIMEOUT;
+    }
+    for( size_t i = 0; i < values.size(); i++ )
+    {
+        sdoWriteAsync( values[i].first, values[i].second, batch->completion( i, batch ) );
+    }
+    return waitSdoBatch( batch, results, timeout );
+}
+
+//--------------------------------------------------------------
+// SDO block transfer
+
+// CRC used by the SDO block transfer: CCITT, polynomial 0x1021, initial value 0.
+static uint16_t sdoBlockCrc(const uint8_t* data, size_t length)
+{
+    uint16_t crc = 0;
+    for( size_t i = 0; i < length; i++ )
+    {
+        crc ^= static_cast<uint16_t>( data[i] ) << 8;
+        for( int b = 0; b < 8; b++ )
+        {
+            crc = ( crc & 0x8000 ) ? static_cast<uint16_t>( (crc << 1) ^ 0x1021 ) : static_cast<uint16_t>( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+static CanMessage sdoBlockFrame(uint8_t node_id, uint8_t command, bool wait_answer)
+{
+    CanMessage msg;
+    msg.cob_id = SDO_RX + node_id;
+    msg.len = 8;
+    memset( msg.data, 0, 8 );
+    msg.data[0] = command;
+    if( wait_answer )
+    {
+        msg.wait_answer    = NEED_TO_WAIT_ANSWER;
+        msg.desired_answer = SDO_TX + node_id;
+    }
+    else{
+        msg.wait_answer = NO_WAIT;
+    }
+    return msg;
+}
+
+// SDO requests of this node. The first segment of each block uploaded by the slave unblocks the
+// queue: any other SDO request would be sent in the middle of the block, therefore they are held
+// back until the last block was received (or the transfer failed).
+void CO301_Interface::pushSdoRequest(const CanMessage& msg)
+{
+    LockGuard lock( _d->block_mutex );
+    if( _d->block.state == Impl::BLOCK_UPLOAD_INITIATE || _d->block.state == Impl::BLOCK_UPLOAD_RECEIVING )
+    {
+        _d->held_sdo_requests.push_back( msg );
+        return;
+    }
+    pushMessage( msg );
+}
+
+// To be called with block_mutex locked.
+void CO301_Interface::releaseSdoRequests()
+{
+    for( const CanMessage& msg: _d->held_sdo_requests )
+    {
+        pushMessage( msg );
+    }
+    _d->held_sdo_requests.clear();
+}
+
+void CO301_Interface::setSdoBlockSize( uint8_t segments )
+{
+    if( segments < 1 || segments > 127 )
+    {
+        throw RangeException("setSdoBlockSize: the block size must be between 1 and 127");
+    }
+    LockGuard lock( _d->block_mutex );
+    _d->block_size = segments;
+}
+
+uint8_t CO301_Interface::getSdoBlockSize() const
+{
+    return _d->block_size;
+}
+
+void CO301_Interface::sdoBlockUploadAsync( ObjectKey const& key, SdoCallback callback, bool use_crc )
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    uint8_t block_size = 0;
+    {
+        LockGuard lock( _d->block_mutex );
+        if( _d->block.state != Impl::BLOCK_IDLE )
+        {
+            throw std::runtime_error("A SDO block transfer is already active on this node");
+        }
+        _d->block = Impl::BlockTransfer();
+        _d->block.state      = Impl::BLOCK_UPLOAD_INITIATE;
+        _d->block.key        = key;
+        _d->block.block_size = _d->block_size;
+        _d->block.use_crc    = use_crc;
+        _d->block.callback   = callback;
+        _d->block.start_time = GetTimeNow();
+        block_size = _d->block_size;
+    }
+    // ccs = 5, cs = 0: initiate upload.
+    CanMessage msg = sdoBlockFrame( node_ID(), 0xA0 | (use_crc ? 0x04 : 0), true );
+    msg.data[1] = entry.index() & 0x00FF;
+    msg.data[2] = (entry.index() >> 8)& 0x00FF;
+    msg.data[3] = entry.subindex();
+    msg.data[4] = block_size;
+    msg.data[5] = 0; // never switch to the segmented protocol
+    pushMessage( msg );
+}
+
+void CO301_Interface::sdoBlockDownloadAsync( ObjectKey const& key, const uint8_t* data, size_t length, SdoCallback callback, bool use_crc )
+{
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    if( length == 0 )
+    {
+        throw std::runtime_error("sdoBlockDownloadAsync: nothing to write");
+    }
+    {
+        LockGuard lock( _d->block_mutex );
+        if( _d->block.state != Impl::BLOCK_IDLE )
+        {
+            throw std::runtime_error("A SDO block transfer is already active on this node");
+        }
+        _d->block = Impl::BlockTransfer();
+        _d->block.state      = Impl::BLOCK_DOWNLOAD_INITIATE;
+        _d->block.key        = key;
+        _d->block.buffer.assign( data, data + length );
+        _d->block.use_crc    = use_crc;
+        _d->block.callback   = callback;
+        _d->block.start_time = GetTimeNow();
+    }
+    // ccs = 6, cs = 0: initiate download, size indicated.
+    CanMessage msg = sdoBlockFrame( node_ID(), 0xC2 | (use_crc ? 0x04 : 0), true );
+    msg.data[1] = entry.index() & 0x00FF;
+    msg.data[2] = (entry.index() >> 8)& 0x00FF;
+    msg.data[3] = entry.subindex();
+    msg.data[4] = length & 0xFF;
+    msg.data[5] = (length >>  8) & 0xFF;
+    msg.data[6] = (length >> 16) & 0xFF;
+    msg.data[7] = (length >> 24) & 0xFF;
+    pushMessage( msg );
+}
+
+// To be called with block_mutex locked. The segments are pushed in front of the queue, so that
+// no other SDO request of this node is sent in the middle of a block.
+void CO301_Interface::sendBlockDownloadSegments()
+{
+    Impl::BlockTransfer& block = _d->block;
+    const std::vector<uint8_t>& buffer = block.buffer;
+
+    size_t pos = block.offset;
+    uint8_t seqno = 0;
+    block.last_sent = false;
+
+    while( seqno < block.block_size && !block.last_sent )
+    {
+        seqno++;
+        const size_t bytes = std::min( static_cast<size_t>(7), buffer.size() - pos );
+        block.last_sent = ( pos + bytes >= buffer.size() );
+
+        const bool end_of_block = ( seqno == block.block_size || block.last_sent );
+        CanMessage msg = sdoBlockFrame( node_ID(), seqno | (block.last_sent ? 0x80 : 0), end_of_block );
+        memcpy( &msg.data[1], &buffer[pos], bytes );
+        pushMessage( msg, true );
+        pos += bytes;
+    }
+    block.segments_in_block = seqno;
+}
+
+void CO301_Interface::abortBlockTransfer(uint32_t abort_code)
+{
+    ObjectKey key;
+    {
+        LockGuard lock( _d->block_mutex );
+        key = _d->block.key;
+    }
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    CanMessage msg = sdoBlockFrame( node_ID(), 0x80, false );
+    msg.data[1] = entry.index() & 0x00FF;
+    msg.data[2] = (entry.index() >> 8)& 0x00FF;
+    msg.data[3] = entry.subindex();
+    msg.data[4] = abort_code & 0xFF;
+    msg.data[5] = (abort_code >>  8) & 0xFF;
+    msg.data[6] = (abort_code >> 16) & 0xFF;
+    msg.data[7] = (abort_code >> 24) & 0xFF;
+    pushMessage( msg, true );
+}
+
+void CO301_Interface::finishBlockTransfer(DataStatus status, uint32_t abort_code, TimePoint answer_time)
+{
+    Impl::BlockTransfer block;
+    {
+        LockGuard lock( _d->block_mutex );
+        if( _d->block.state == Impl::BLOCK_IDLE ) return;
+        std::swap( block, _d->block );
+        _d->block = Impl::BlockTransfer();
+        releaseSdoRequests();
+    }
+    can_port()->executor()->delAlarm( _d->block_alarm );
+
+    SdoResult result;
+    result.key        = block.key;
+    result.status     = status;
+    result.abort_code = abort_code;
+    if( answer_time >= block.start_time )
+    {
+        result.rtt = std::chrono::duration_cast<Microseconds>( answer_time - block.start_time );
+    }
+    if( status == DS_NEW_DATA )
+    {
+        const char* raw = reinterpret_cast<const char*>( block.buffer.data() );
+        result.value = Variant( raw, block.buffer.size() );
+        receivedNewBuffer( block.key, block.buffer.data(), block.buffer.size(), answer_time );
+    }
+    if( block.callback )
+    {
+        block.callback( result );
+    }
+}
+
+// Returns true if the message was consumed by the block transfer in progress.
+bool CO301_Interface::SDO_BlockInterpreter(const CanMessage & m)
+{
+    const uint8_t command = m.data[0];
+    const uint8_t scs     = (command >> 5) & 0x7;
+    const TimePoint msg_tp = TimePoint() + Microseconds(m.timestamp_usec);
+
+    enum { CONTINUE, COMPLETED, FAILED, ABORTED } outcome = CONTINUE;
+    uint32_t abort_code = 0;
+    bool arm_alarm = false;
+    {
+        LockGuard lock( _d->block_mutex );
+        Impl::BlockTransfer& block = _d->block;
+
+        if( block.state == Impl::BLOCK_IDLE )
+        {
+            return false;
+        }
+        if( command == 0x80 ) // abort from the slave (not a valid segment, since seqno can't be 0)
+        {
+            outcome = ABORTED;
+        }
+        else switch( block.state )
+        {
+        case Impl::BLOCK_UPLOAD_INITIATE:
+        {
+            if( scs != 6 || (command & 0x01) != 0 ) return false;
+            block.use_crc = block.use_crc && (command & 0x04);
+            if( command & 0x02 ) // size indicated
+            {
+                block.expected_size = m.data[4] + (m.data[5]<<8) + (m.data[6]<<16) + (static_cast<uint32_t>(m.data[7])<<24);
+                // the size comes from the slave: beyond SDO_MAX_RESERVE, the buffer grows with the segments.
+                block.buffer.reserve( std::min( block.expected_size, SDO_MAX_RESERVE ) + 7 );
+            }
+            block.state = Impl::BLOCK_UPLOAD_RECEIVING;
+            block.last_seqno = 0;
+            // ccs = 5, cs = 3: start upload. The first segment is the answer.
+            pushMessage( sdoBlockFrame( node_ID(), 0xA3, true ), true );
+            arm_alarm = true;
+        }break;
+
+        case Impl::BLOCK_UPLOAD_RECEIVING:
+        {
+            const uint8_t seqno = command & 0x7F;
+            const bool    last  = (command & 0x80) != 0;
+            const bool in_sequence = ( seqno == block.last_seqno + 1 );
+            if( in_sequence )
+            {
+                block.buffer.insert( block.buffer.end(), &m.data[1], &m.data[8] );
+                block.last_seqno = seqno;
+            }
+            if( last || seqno >= block.block_size )
+            {
+                // acknowledge the segments received in sequence; the slave repeats the others.
+                CanMessage ack = sdoBlockFrame( node_ID(), 0xA2, true );
+                ack.data[1] = block.last_seqno;
+                ack.data[2] = block.block_size;
+                block.last_seqno = 0;
+                pushMessage( ack, true );
+                if( last && in_sequence )
+                {
+                    // the answer of this ack is the end of the transfer.
+                    block.state = Impl::BLOCK_UPLOAD_END;
+                    releaseSdoRequests();
+                }
+            }
+            arm_alarm = ( block.state == Impl::BLOCK_UPLOAD_RECEIVING );
+        }break;
+
+        case Impl::BLOCK_UPLOAD_END:
+        {
+            if( scs != 6 || (command & 0x03) != 1 ) return false;
+            const size_t unused = (command >> 2) & 0x7;
+            block.buffer.resize( block.buffer.size() - std::min( unused, block.buffer.size() ) );
+
+            const uint16_t crc = m.data[1] + (m.data[2]<<8);
+            if( block.expected_size != 0 && block.expected_size != block.buffer.size() )
+            {
+                outcome = FAILED;
+                abort_code = 0x06070010; // length of service parameter does not match
+            }
+            else if( block.use_crc && crc != sdoBlockCrc( block.buffer.data(), block.buffer.size() ) )
+            {
+                outcome = FAILED;
+                abort_code = 0x05040004; // CRC error
+            }
+            else{
+                // ccs = 5, cs = 1: end upload.
+                pushMessage( sdoBlockFrame( node_ID(), 0xA1, false ), true );
+                outcome = COMPLETED;
+            }
+        }break;
+
+        case Impl::BLOCK_DOWNLOAD_INITIATE:
+        {
+            if( scs != 5 || (command & 0x03) != 0 ) return false;
+            block.use_crc    = block.use_crc && (command & 0x04);
+            block.block_size = std::max<uint8_t>( 1, std::min<uint8_t>( 127, m.data[4] ) );
+            block.offset     = 0;
+            block.state      = Impl::BLOCK_DOWNLOAD_SENDING;
+            sendBlockDownloadSegments();
+        }break;
+
+        case Impl::BLOCK_DOWNLOAD_SENDING:
+        {
+            if( scs != 5 || (command & 0x03) != 2 ) return false;
+            const uint8_t ackseq = std::min( m.data[1], block.segments_in_block );
+
+            if( block.last_sent && ackseq == block.segments_in_block )
+            {
+                // ccs = 6, cs = 1: end download. n = number of bytes of the last segment without data.
+                const size_t size   = block.buffer.size();
+                const uint8_t unused = static_cast<uint8_t>( (7 - size % 7) % 7 );
+                const uint16_t crc = block.use_crc ? sdoBlockCrc( block.buffer.data(), size ) : 0;
+                CanMessage msg = sdoBlockFrame( node_ID(), 0xC1 | (unused << 2), true );
+                msg.data[1] = crc & 0xFF;
+                msg.data[2] = (crc >> 8) & 0xFF;
+                block.state = Impl::BLOCK_DOWNLOAD_END;
+                pushMessage( msg, true );
+            }
+            else{
+                block.offset += ackseq * 7;
+                block.block_size = std::max<uint8_t>( 1, std::min<uint8_t>( 127, m.data[2] ) );
+                sendBlockDownloadSegments();
+            }
+        }break;
+
+        case Impl::BLOCK_DOWNLOAD_END:
+        {
+            if( scs != 5 || (command & 0x03) != 1 ) return false;
+            outcome = COMPLETED;
+        }break;
+
+        default: break;
+        }
+    }
+
+    if( arm_alarm )
+    {
+        can_port()->executor()->setAlarm( _d->block_alarm, [this]()
+        {
+            bool expired;
+            {
+                LockGuard lock( _d->block_mutex );
+                expired = ( _d->block.state == Impl::BLOCK_UPLOAD_RECEIVING );
+            }
+            if( expired )
+            {
+                Log::CO301()->warn("node {}: timeout during SDO block upload", (int)node_ID() );
+                abortBlockTransfer( 0x05040000 ); // SDO protocol timed out
+                finishBlockTransfer( DS_TIMEOUT, 0, TimePoint() );
+            }
+        }, sdoAnswerTimeout() );
+    }
+
+    switch( outcome )
+    {
+    case COMPLETED:
+        finishBlockTransfer( DS_NEW_DATA, 0, msg_tp );
+        break;
+    case FAILED:
+        abortBlockTransfer( abort_code );
+        finishBlockTransfer( DS_NO_DATA, abort_code, msg_tp );
+        break;
+    case ABORTED:
+        finishBlockTransfer( DS_NO_DATA, m.data[4] + (m.data[5]<<8) + (m.data[6]<<16) + (m.data[7]<<24), msg_tp );
+        return false; // let SDO_Interpreter log the abort and notify the events.
+    default: break;
+    }
+    return true;
+}
+
+int CO301_Interface::receivedNewBuffer(ObjectKey const& key, const uint8_t * data, size_t length, TimePoint timestamp)
+{
+    LockGuard lock( _d->wait_mutex );
+
+    _d->object_database.setValueFromBuffer( key, data, length, timestamp );
+
+    EventData event;
+    event.timestamp = timestamp;
+
+    const ObjectEntry& entry = _d->object_dictionary_ptr->getEntry(key);
+    event.info = EventDataObjectUpdated( entry, _d->object_database.getData(key) );
+    event.event_id = entry.id().get();
+    this->events()->push_event(device_ID(), event );
+
+    return length;
+}
+
+} // namespace CanMoveIt */
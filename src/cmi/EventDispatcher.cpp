@@ -23,6 +23,7 @@
 #include <boost/circular_buffer.hpp>
 #include <boost/serialization/strong_typedef.hpp>
 #include <boost/asio.hpp>
+#include <atomic>
 
 namespace CanMoveIt{
 
@@ -61,6 +62,17 @@ struct EventDispatcher::Impl
 
     std::multimap<EventID, EventInfo>     info_list;
     RecursiveMutex                        mutex;
+
+    // Number of subscriptions for each bucket of EventIDs, read without locking by hasSubscribers.
+    enum{ NUM_BUCKETS = 1024 };
+    std::atomic<uint16_t>                 subscriptions[NUM_BUCKETS];
+
+    static size_t bucket(EventID id) { return (id ^ (id >> 10) ^ (id >> 20)) % NUM_BUCKETS; }
+
+    Impl()
+    {
+        for( auto& count: subscriptions ) count = 0;
+    }
 };
 
 
@@ -89,6 +101,7 @@ EventPtr EventDispatcher::add_subscription(EventID const&  id, EventMode const&
     info.callback = callback;
 
     Impl::map_iterator it = _d->info_list.insert( std::make_pair(id, info));
+    _d->subscriptions[ Impl::bucket(id) ]++;
     return it;
 }
 
@@ -118,6 +131,7 @@ void EventDispatcher::eraseEvent(EventPtr event)
 {
     RecursiveLockGuard lock( _d->mutex );
     Impl::map_iterator it = absl::any_cast<Impl::map_iterator>( event );
+    _d->subscriptions[ Impl::bucket(it->first) ]--;
     _d->info_list.erase( it );
 }
 
@@ -128,7 +142,10 @@ void EventDispatcher::eraseEvents(EventID const& event_id )
     for(auto it = _d->info_list.begin(); it != _d->info_list.end(); )
     {
         if(it->first == event_id)
+        {
+            _d->subscriptions[ Impl::bucket(event_id) ]--;
             it = _d->info_list.erase(it);
+        }
         else
             ++it;
     }
@@ -137,6 +154,11 @@ void EventDispatcher::eraseEvents(EventID const& event_id )
 
 //--------------------------------------------------------
 
+bool EventDispatcher::hasSubscribers(EventID const& id) const
+{
+    return _d->subscriptions[ Impl::bucket(id) ].load( std::memory_order_relaxed ) != 0;
+}
+
 void EventDispatcher::push_event(uint16_t device_id, EventData const& data)
 {
     RecursiveLockGuard lock( _d->mutex  );
@@ -62,7 +62,7 @@ public:
         profiled_acceleration(0xFF),
         profiled_deceleration(0xFF),
         profiled_velocity(0xFF),
-        current_actual_value(0xFF),
+        current_actual_value(ObjectsDictionary::NOT_FOUND),
         raw_statusword(0),
         IP_period(1),
         status( STATUS_NOT_INITIALIZED ),
@@ -205,7 +205,7 @@ CommandResult MAL_CANOpen402::configureDrive(const char*)
         PDO_MappingList obj_list;
         obj_list.push_back ( STATUSWORD );
 
-        if( _d->current_actual_value != ObjectKey(0xFF))
+        if( _d->current_actual_value != ObjectKey(ObjectsDictionary::NOT_FOUND) )
         {
             obj_list.push_back ( _d->CO_interface->getObjectID( _d->current_actual_value )  );
         }
@@ -273,7 +273,7 @@ CommandResult MAL_CANOpen402::startDrive()
     int attempts = 0;
     do {
         Variant sw_value = 0xFF;
-        co301()->sdoRequestAndGet( _d->statusword, &sw_value, Microseconds(100*1000) );
+        co301()->sdoRequestAndGet( _d->statusword, &sw_value, co301()->sdoAnswerTimeout() );
 
         if( sw_value != 0xFF )
         {
@@ -304,7 +304,8 @@ CommandResult MAL_CANOpen402::startDrive()
                 Log::MAL()->warn("startDrive doesn't know what to do on status {} ", _status);
             } break;
             }
-            co301()->waitQueueEmpty( Milliseconds(100) );
+            // up to three SDO writes, each one waiting for its answer.
+            co301()->waitQueueEmpty( co301()->getReadTimeout() * 3 );
         }
         if( attempts++ > 50)
         {
@@ -372,11 +373,7 @@ void MAL_CANOpen402::stopDrive()
 
 CommandResult MAL_CANOpen402::pushInterpolatedPositionTarget(double pos_in_rad, double vel_rad_sec)
 {
-    ObjectKey interpolated_data;
-    try{
-        interpolated_data =  co301()->findObjectKey( INTERPOLATED_DATA_RECORD, 1);
-    }
-    catch(std::runtime_error) { interpolated_data = ObjectKey(0xFF) ; }
+    const ObjectKey interpolated_data = co301()->tryFindObjectKey( ObjectID(INTERPOLATED_DATA_RECORD, 1) );
 
     if (this->_mode_operation != INTERPOLATED_POSITION_MODE)
     {
@@ -392,7 +389,7 @@ CommandResult MAL_CANOpen402::pushInterpolatedPositionTarget(double pos_in_rad,
     uint8_t data[8];
     uint8_t data_length = 0;
 
-    if( interpolated_data != ObjectKey(0xFF) )
+    if( interpolated_data != ObjectKey(ObjectsDictionary::NOT_FOUND) )
     {
         data[0] = (int_pos_ref)    & 0xFF;
         data[1] = (int_pos_ref>>8) & 0xFF;
@@ -628,6 +625,12 @@ DataStatus MAL_CANOpen402::getActualCurrent(int32_t* act_curr)
     DataStatus res ;
     Variant current_actual( 0 );
 
+    if( _d->current_actual_value == ObjectKey(ObjectsDictionary::NOT_FOUND) )
+    {
+        // the drive has neither CURRENT_ACTUAL_VALUE nor TORQUE_DEMAND_VALUE.
+        *act_curr = 0;
+        return DS_NO_DATA;
+    }
     res = co301()->getLastObjectReceived( _d->current_actual_value, &current_actual);
 
     *act_curr = ( current_actual.convert<int32_t>() );
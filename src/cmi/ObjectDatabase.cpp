@@ -20,6 +20,8 @@
 #include "cmi/ObjectDatabase.h"
 #include <fstream>
 #include <vector>
+#include <atomic>
+#include <thread>
 
 namespace CanMoveIt
 {
@@ -53,20 +55,20 @@ ObjectData::ObjectData( ObjectEntry* entry):
 {
     switch( entry->type() )
     {
-    case UINT8:   _data = (uint8_t) 0;
-    case UINT16:  _data = (uint16_t) 0;
-    case UINT32:  _data = (uint32_t) 0;
-    case UINT64:  _data = (uint64_t) 0;
+    case UINT8:   _data = (uint8_t) 0; break;
+    case UINT16:  _data = (uint16_t) 0; break;
+    case UINT32:  _data = (uint32_t) 0; break;
+    case UINT64:  _data = (uint64_t) 0; break;
 
-    case INT8:    _data = (int8_t) 0;
-    case INT16:   _data = (int16_t) 0;
-    case INT32:   _data = (int32_t) 0;
-    case INT64:   _data = (int64_t) 0;
+    case INT8:    _data = (int8_t) 0; break;
+    case INT16:   _data = (int16_t) 0; break;
+    case INT32:   _data = (int32_t) 0; break;
+    case INT64:   _data = (int64_t) 0; break;
 
-    case FLOAT32: _data = (float) 0;
-    case FLOAT64: _data = (double) 0;
+    case FLOAT32: _data = (float) 0; break;
+    case FLOAT64: _data = (double) 0; break;
 
-    case STRING:  _data = std::string("");
+    case STRING:  _data = std::string(""); break;
 
     default: throw std::runtime_error("Unhandled case");
     }
@@ -80,12 +82,47 @@ public:
 
     DatabaseMap          object_database;
     ObjectsDictionaryPtr object_dictionary;
-    RW_Mutex             od_mutex;
+    RW_Mutex             od_mutex;   // STRING and domain entries only.
+
+    // Seqlock of each numeric entry: the counter is odd while a writer is modifying the entry.
+    // Readers never block (they retry if the counter changed while they were copying the value)
+    // and writers only exclude each other.
+    std::unique_ptr< std::atomic<uint32_t>[] > sequence;
+
     Impl( ObjectsDictionaryPtr dictionary):  object_dictionary(dictionary) {}
+
+    static bool isNumeric(const ObjectData& obj) { return getSize( obj.type() ) > 0; }
+
+    uint32_t beginWrite(ObjectKey const& key)
+    {
+        std::atomic<uint32_t>& seq = sequence[key];
+        uint32_t s = seq.load( std::memory_order_relaxed );
+        while( (s & 1) || !seq.compare_exchange_weak( s, s + 1, std::memory_order_acquire ) )
+        {
+            if( s & 1 )
+            {
+                std::this_thread::yield();
+                s = seq.load( std::memory_order_relaxed );
+            }
+        }
+        // the counter must be odd before any store to the entry is visible.
+        std::atomic_thread_fence( std::memory_order_release );
+        return s + 1;
+    }
+
+    void endWrite(ObjectKey const& key, uint32_t s)
+    {
+        sequence[key].store( s + 1, std::memory_order_release );
+    }
 };
 
 
-ObjectsDatabase::ObjectsDatabase (ObjectsDictionaryPtr dictionary): _d( new Impl(dictionary) )
+ObjectsDatabase::ObjectsDatabase (ObjectsDictionaryPtr dictionary):
+    _d( new Impl(dictionary) ),
+    _slots( nullptr ),
+    _sequence( nullptr ),
+    _entries( nullptr ),
+    _num_slots( 0 )
 {
     rebuild();
 }
@@ -104,13 +141,30 @@ void ObjectsDatabase::rebuild(ObjectsDictionaryPtr dictionary )
 
     _d->object_database.clear();
     _d->object_database.reserve( s );
+    _d->sequence.reset( new std::atomic<uint32_t>[s] );
 
     for (int i=0; i< s; i++)
     {
         ObjectEntry *entry = &( _d->object_dictionary->at(i) );
         ObjectData  obj( entry );
         _d->object_database.push_back( obj );
+        _d->sequence[i] = 0;
     }
+
+    _slots     = _d->object_database.data();
+    _sequence  = _d->sequence.get();
+    _entries   = &( _d->object_dictionary->at(0) );
+    _num_slots = s;
+}
+
+ObjectKey ObjectsDatabase::resolveKey(ObjectID id, TypeID type) const
+{
+    const ObjectKey key = _d->object_dictionary->find( id.index(), id.subindex() );
+    if( _entries[key].type() != type )
+    {
+        throw TypeException("ObjectsDatabase: the type of the ObjectRef doesn't match the type in the dictionary");
+    }
+    return key;
 }
 
 ObjectsDatabase::~ObjectsDatabase()
@@ -129,34 +183,107 @@ ObjectData& ObjectsDatabase::getData(ObjectKey const& key)
 
 DataStatus  ObjectsDatabase::getValue(ObjectKey const& key, Variant *value )
 {
-    ScopedReadLock lock( &_d->od_mutex );
     ObjectData& obj = getData(key);
 
-    DataStatus temp = obj.get_isnew();
-    *value = obj.get();
-    return temp;
+    if( !Impl::isNumeric( obj ) )
+    {
+        ScopedReadLock lock( &_d->od_mutex );
+        DataStatus temp = obj.get_isnew();
+        *value = obj.get();
+        return temp;
+    }
+
+    const std::atomic<uint32_t>& seq = _d->sequence[key];
+    while( true )
+    {
+        const uint32_t before = readSequence( seq );
+        const DataStatus temp  = obj.get_isnew();
+        const Variant snapshot = obj.get();
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( seq.load( std::memory_order_relaxed ) == before )
+        {
+            *value = snapshot;
+            return temp;
+        }
+    }
 }
 
 void ObjectsDatabase::setValue(ObjectKey const& key, Variant const& value, TimePoint timestamp)
 {
-    ScopedWriteLock lock( &_d->od_mutex );
-
     ObjectData& obj = getData(key);
-    obj.set( value , timestamp );
-    obj.set_isnew ( DS_NEW_DATA );
+
+    if( !Impl::isNumeric( obj ) )
+    {
+        ScopedWriteLock lock( &_d->od_mutex );
+        obj.set( value , timestamp );
+        obj.set_isnew ( DS_NEW_DATA );
+        return;
+    }
+    if( value.getTypeID() == STRING )
+    {
+        throw TypeException("ObjectsDatabase::setValue -> can't store a STRING in a numeric entry");
+    }
+    const uint32_t s = _d->beginWrite( key );
+    try{
+        obj.set( value , timestamp );
+        obj.set_isnew ( DS_NEW_DATA );
+    }
+    catch( ... )
+    {
+        _d->endWrite( key, s );
+        throw;
+    }
+    _d->endWrite( key, s );
 }
 
 uint8_t ObjectsDatabase::setValueFromBytes(ObjectKey const& key, const uint8_t *bytes, TimePoint timestamp)
 {
-    ScopedWriteLock lock( &_d->od_mutex );
     ObjectData& obj = getData(key);
+    if( !Impl::isNumeric( obj ) )
+    {
+        ScopedWriteLock lock( &_d->od_mutex );
+        obj.get().copyFromBytes( bytes );
+        obj.setTimestamp(timestamp);
+        obj.set_isnew ( DS_NEW_DATA );
+        return ( obj.size() );
+    }
 
+    const uint32_t s = _d->beginWrite( key );
     obj.get().copyFromBytes( bytes );
     obj.setTimestamp(timestamp);
     obj.set_isnew ( DS_NEW_DATA );
+    _d->endWrite( key, s );
     return ( obj.size() );
 }
 
+void ObjectsDatabase::setValuesFromBytes(const ObjectKey* keys, const uint8_t* const* bytes, size_t count, TimePoint timestamp)
+{
+    for( size_t i = 0; i < count; i++ )
+    {
+        setValueFromBytes( keys[i], bytes[i], timestamp );
+    }
+}
+
+void ObjectsDatabase::setValueFromBuffer(ObjectKey const& key, const uint8_t *bytes, size_t length, TimePoint timestamp)
+{
+    ObjectData& obj = getData(key);
+
+    const int size = getSize( obj.type() );
+    if( size < 0 ) // STRING or domain
+    {
+        ScopedWriteLock lock( &_d->od_mutex );
+        obj.get().assign( reinterpret_cast<const char*>(bytes), length );
+        obj.setTimestamp(timestamp);
+        obj.set_isnew ( DS_NEW_DATA );
+    }
+    else{
+        uint8_t padded[8] = {0,0,0,0,0,0,0,0};
+        memcpy( padded, bytes, std::min( length, static_cast<size_t>(size) ) );
+        setValueFromBytes( key, padded, timestamp );
+    }
+}
+
 
 } //end namespace
 
@@ -19,40 +19,72 @@
 
 #include <fstream>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <cstring>
+#include <cctype>
+#include <set>
 #include "cmi/ObjectDictionary.h"
 #include "cmi/globals.h"
 #include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/match.h"
+#include "OS/MappedFile.h"
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 #define PRINTF if(0) printf
 
 namespace CanMoveIt
 {
 
-inline void checkStreamString( std::stringstream& ss, const std::string& s)
+typedef absl::string_view StringView;
+
+inline bool isBlank(char c)
+{
+    return ( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+}
+
+inline StringView trim(StringView s)
 {
-    if( ss.fail() )
+    while( !s.empty() && isBlank( s.front() ) ) s.remove_prefix(1);
+    while( !s.empty() && isBlank( s.back() ) )  s.remove_suffix(1);
+    return s;
+}
+
+// strtoX needs a null terminated string, but the text of the EDS isn't.
+inline void copyNumber( StringView s, char* buffer, size_t capacity)
+{
+    s = trim(s);
+    if( s.empty() || s.size() >= capacity )
     {
         throw std::runtime_error ("Not a valid number ");
     }
-    else while( !ss.eof() )
+    memcpy( buffer, s.data(), s.size() );
+    buffer[ s.size() ] = '\0';
+}
+
+inline void checkNumberEnd( const char* buffer, const char* end)
+{
+    if( end == buffer || *end != '\0' )
     {
-        char c = '\r';
-        ss >> c;
-        if( c !='\r' && c !=' ' && c !='\n' )
-        {
-            throw std::runtime_error ("Not a valid number ");
-        }
+        throw std::runtime_error ("Not a valid number ");
     }
 }
 
-template <typename T> T NumberParserHex(const std::string& s)
+template <typename T> T NumberParserHex(StringView s)
 {
-    uint64_t from;
+    char buffer[32];
+    copyNumber( s, buffer, sizeof(buffer) );
 
-    std::stringstream ss;
-    ss << std::hex << s;
-    ss >> from;
-    checkStreamString(ss,s);
+    char* end;
+    const uint64_t from = strtoull( buffer, &end, 16 );
+    checkNumberEnd( buffer, end );
 
     if( sizeof(T) == 1 && from > 0xFF)
     {
@@ -69,45 +101,38 @@ template <typename T> T NumberParserHex(const std::string& s)
     return static_cast<T>(from);
 }
 
-template <typename T> T NumberParser(const std::string& s)
+// Hexadecimal if it contains "0x" (it takes care of "$NODEID+0x180" too), decimal otherwise.
+template <typename T> T NumberParser(StringView s)
 {
     size_t pos = s.find("0x");
-    if( pos == std::string::npos)
+    if( pos == StringView::npos)
     {
-        s.find("0X");
+        pos = s.find("0X");
     }
-    if( pos != std::string::npos)
+    if( pos != StringView::npos)
     {
-        std::string tmp = s;
-        tmp.erase(0, pos+2);
-        return NumberParserHex<T>(tmp);
+        return NumberParserHex<T>( s.substr(pos+2) );
     }
     //-------------------
-    T to;
-    std::stringstream ss;
-    ss << s;
+    char buffer[32];
+    copyNumber( s, buffer, sizeof(buffer) );
+    char* end;
 
     if( std::is_integral<T>::value == false )
     {
-        float from;
-        ss >> from;
-        checkStreamString(ss,s);
-        Variant var( from );
-        to = var.convert<T>();
+        const float from = strtof( buffer, &end );
+        checkNumberEnd( buffer, end );
+        return Variant( from ).convert<T>();
     }
     else
     {
-        int32_t from;
-        ss >> from;
-        checkStreamString(ss,s);
-        Variant var( from );
-        to = var.convert<T>();
+        const int64_t from = strtoll( buffer, &end, 10 );
+        checkNumberEnd( buffer, end );
+        return Variant( from ).convert<T>();
     }
-
-    return to;
 }
 
-inline bool compareObjectEntries( ObjectEntry a, ObjectEntry b) { return a.id().get() < b.id().get(); }
+inline bool compareObjectEntries( ObjectEntry const& a, ObjectEntry const& b) { return a.id().get() < b.id().get(); }
 
 inline TypeID convert_EDS_Types( int const&  type )
 {
@@ -128,7 +153,7 @@ inline TypeID convert_EDS_Types( int const&  type )
     return OTHER;
 }
 
-inline Variant variantFromString(TypeID entry_type, const  std::string& line)
+inline Variant variantFromString(TypeID entry_type, StringView line)
 {
     switch (entry_type)
     {
@@ -148,37 +173,15 @@ inline Variant variantFromString(TypeID entry_type, const  std::string& line)
 }
 
 
-class ObjectEntry::Impl{
+Variant  ObjectEntry::default_value()   const   { return _default_value ? *_default_value : Variant(); }
 
-public:
-#ifndef EMBEDDED
-    std::string parameter_name;
-    Variant  default_value;
-#endif
-    ObjectID id;
-
-    struct{
-        uint8_t  access_type    : 2;
-        uint8_t  PDO_mapable    : 1;
-        uint8_t  raw_type       : 5;
-    };
-
-    Impl(): id(ObjectID(0,0)), raw_type(OTHER) {}
-};
-
-TypeID      ObjectEntry::type()            const   { return  static_cast<TypeID>(_d->raw_type ); }
-uint8_t     ObjectEntry::size()            const   { return  getSize( type() );   }
-ObjectID    ObjectEntry::id()              const   { return _d->id; }
-uint16_t    ObjectEntry::index()           const   { return _d->id.index() ; }
-uint8_t     ObjectEntry::subindex()        const   { return _d->id.subindex() ;  }
-bool        ObjectEntry::PDO_is_mapable()  const   { return _d->PDO_mapable ; }
-ObjectEntry::AccessType  ObjectEntry::access_type()     const   { return static_cast<AccessType>(_d->access_type); }
-bool        ObjectEntry::empty()           const   { return ( type() == OTHER || _d->id == ObjectID(0,0)); }
-const char* ObjectEntry::name()            const   { return _d->parameter_name.c_str(); }
-
-Variant  ObjectEntry::default_value()   const   { return _d->default_value; }
-
-ObjectEntry::ObjectEntry(): _d( new Impl)
+ObjectEntry::ObjectEntry():
+    _id( ObjectID(0,0) ),
+    _access_type( CNST ),
+    _PDO_mapable( 0 ),
+    _raw_type( OTHER ),
+    _name( NULL ),
+    _default_value( NULL )
 {
 
 }
@@ -188,54 +191,249 @@ ObjectEntry::ObjectEntry(uint16_t index,
                          AccessType access,
                          bool mappable,
                          TypeID type,
-                         const char* description,
-                         Variant default_val)
-    :_d( new Impl)
-{
-    _d->id = ObjectID(index, subindex );
-    _d->access_type = (access);
-    _d->PDO_mapable = (mappable);
-    _d->raw_type = type;
-#ifndef EMBEDDED
-    if(description) _d->parameter_name = std::string(description);
-    _d->default_value = default_val;
-#endif
+                         const char* description)
+    :_id( ObjectID(index, subindex ) ),
+     _access_type( access ),
+     _PDO_mapable( mappable ),
+     _raw_type( type ),
+     _name( description ),
+     _default_value( NULL )
+{
+
 }
 
 
 void ObjectEntry::print() const
 {
 #ifndef EMBEDDED
-    printf("Entry with name: %s\n", _d->parameter_name.c_str());
+    printf("Entry with name: %s\n", name() );
 #endif
-    printf("index: 0x%X    subindex: 0x%X\n", _d->id.index(), _d->id.subindex());
-    printf("access type = %d\n", _d->access_type);
+    printf("index: 0x%X    subindex: 0x%X\n", _id.index(), _id.subindex());
+    printf("access type = %d\n", access_type() );
     printf("type = %s\n", toStr( type() ) );
 }
 //--------------------------------------------------------------
+static const uint16_t LOOKUP_NO_PAGE = 0xFFFF;
+
+// Lines of a single block of the EDS: it stops before the header of the next block.
+class BlockReader
+{
+public:
+    BlockReader(const char* begin, const char* end): _cursor(begin), _end(end) {}
+
+    static bool isHeader(StringView line)
+    {
+        return ( line.find('[') != StringView::npos && line.find(']') != StringView::npos);
+    }
+
+    // false at the end of the block.
+    bool next(StringView* line)
+    {
+        if( _cursor >= _end ) return false;
+
+        const char* eol = static_cast<const char*>( memchr( _cursor, '\n', _end - _cursor ) );
+        if( !eol ) eol = _end;
+
+        StringView current( _cursor, eol - _cursor );
+        if( isHeader( current ) ) return false;
+
+        _cursor = ( eol == _end ) ? _end : eol + 1;
+        *line = current;
+        return true;
+    }
+
+    void skipBlock()
+    {
+        StringView line;
+        while( next( &line ) ) {}
+    }
+
+    // the header of the next block must be the current line.
+    StringView header()
+    {
+        const char* eol = static_cast<const char*>( memchr( _cursor, '\n', _end - _cursor ) );
+        if( !eol ) eol = _end;
+        StringView line( _cursor, eol - _cursor );
+        _cursor = ( eol == _end ) ? _end : eol + 1;
+        return line;
+    }
+
+    bool finished() const { return _cursor >= _end; }
+
+private:
+    const char* _cursor;
+    const char* _end;
+};
+
+inline bool containsIgnoreCase(StringView text, StringView pattern)
+{
+    for( size_t i = 0; i + pattern.size() <= text.size(); i++ )
+    {
+        if( absl::StartsWithIgnoreCase( text.substr(i), pattern ) ) return true;
+    }
+    return false;
+}
+
+static const size_t NAME_BLOCK_SIZE = 16*1024;
+
+// All the names of a dictionary, stored one after the other in a few large blocks.
+// A block is never reallocated, so the pointers returned by intern stay valid until clear.
+class NameArena
+{
+public:
+    NameArena(): _used( NAME_BLOCK_SIZE ) {}
+
+    const char* intern(const char* str)
+    {
+        if( !str || str[0] == '\0' ) return NULL;
+
+        const size_t length = strlen( str ) + 1;
+        if( _used + length > NAME_BLOCK_SIZE )
+        {
+            _blocks.push_back( std::unique_ptr<char[]>( new char[ std::max( length, NAME_BLOCK_SIZE ) ] ) );
+            _used = 0;
+        }
+        char* ptr = _blocks.back().get() + _used;
+        memcpy( ptr, str, length );
+        _used += length;
+        return ptr;
+    }
+
+    void clear()
+    {
+        _blocks.clear();
+        _used = NAME_BLOCK_SIZE;
+    }
+
+private:
+    std::vector< std::unique_ptr<char[]> > _blocks;
+    size_t _used;
+};
+
 struct ObjectsDictionary::Impl{
+    // The entries are small values (no pointer chasing to read id or type). Names and
+    // default values are stored apart, since they are needed only to print and to configure.
     std::vector<ObjectEntry>  object_entries;
-    ObjectEntry parseBlock(std::stringstream & ss, int num_lines );
+#ifndef EMBEDDED
+    NameArena                 names;
+    std::deque<Variant>       default_values; // stable addresses, referenced by the entries.
+#endif
+    std::unique_ptr<MappedFile> cache_file;   // the names point to it if the dictionary was loaded from a cache.
+    ObjectEntry parseBlock(StringView header, BlockReader& lines, std::string* name, Variant* default_val );
+    void append(ObjectEntry entry, const char* name, Variant const& default_val );
     std::map<uint16_t,std::string> array_index_name;
      uint32_t vendor;
      uint32_t product;
      uint32_t revision ;
+
+    // Lookup table used by find: two levels indexed by the high and the low byte of the index.
+    // Each Span is the range of object_entries (sorted by id) that share the same index.
+    struct Span
+    {
+        uint16_t first;
+        uint16_t count;
+    };
+    typedef std::array<Span, 256> SpanPage;
+
+    std::array<uint16_t, 256>  page_of;   // LOOKUP_NO_PAGE if no entry has this high byte.
+    std::vector<SpanPage>      pages;
+
+    Impl() { page_of.fill( LOOKUP_NO_PAGE ); }
+
+    const Span* span(uint16_t index) const
+    {
+        const uint16_t page = page_of[ index >> 8 ];
+        if( page == LOOKUP_NO_PAGE ) return nullptr;
+        const Span& s = pages[page][ index & 0xFF ];
+        return s.count ? &s : nullptr;
+    }
+
+    void addToLookupTable(uint16_t position);
+    void buildLookupTable();
 };
 
+void ObjectsDictionary::Impl::addToLookupTable(uint16_t position)
+{
+    const uint16_t index = object_entries[position].index();
+    uint16_t& page = page_of[ index >> 8 ];
+    if( page == LOOKUP_NO_PAGE )
+    {
+        page = static_cast<uint16_t>( pages.size() );
+        pages.push_back( SpanPage() );
+        for( Span& s: pages.back() ) { s.first = 0; s.count = 0; }
+    }
+    Span& s = pages[page][ index & 0xFF ];
+    if( s.count == 0 ) s.first = position;
+    s.count++;
+}
+
+// object_entries must be sorted already.
+void ObjectsDictionary::Impl::buildLookupTable()
+{
+    page_of.fill( LOOKUP_NO_PAGE );
+    pages.clear();
+    for( size_t i = 0; i < object_entries.size(); i++ )
+    {
+        addToLookupTable( static_cast<uint16_t>(i) );
+    }
+}
+
+
+void ObjectsDictionary::Impl::append(ObjectEntry entry, const char* name, Variant const& default_val)
+{
+#ifndef EMBEDDED
+    entry._name = names.intern( name );
+    if( default_val.getTypeID() != OTHER )
+    {
+        default_values.push_back( default_val );
+        entry._default_value = &default_values.back();
+    }
+    else{
+        entry._default_value = NULL;
+    }
+#else
+    entry._name = NULL;
+    entry._default_value = NULL;
+#endif
+    object_entries.push_back( entry );
+}
 
 
 ObjectsDictionary::ObjectsDictionary() : _d(new Impl) {}
 ObjectsDictionary::~ObjectsDictionary() { delete _d;}
 
-void ObjectsDictionary::insert(ObjectEntry const& obj)
+void ObjectsDictionary::reserve(uint16_t num_entries)
 {
-    _d->object_entries.push_back( obj );
+    _d->object_entries.reserve( num_entries );
+}
+
+void ObjectsDictionary::insert(ObjectEntry const& obj, Variant const& default_value)
+{
+    const bool sorted = _d->object_entries.empty() ||
+            _d->object_entries.back().id().get() < obj.id().get();
+
+    _d->append( obj, obj._name, default_value );
+
+    if( sorted )
+    {
+        _d->addToLookupTable( static_cast<uint16_t>( _d->object_entries.size() - 1) );
+    }
+    else{
+        std::sort( _d->object_entries.begin(), _d->object_entries.end(), compareObjectEntries );
+        _d->buildLookupTable();
+    }
 }
 
 
 void ObjectsDictionary::clear()
 {
     _d->object_entries.clear();
+#ifndef EMBEDDED
+    _d->names.clear();
+    _d->default_values.clear();
+#endif
+    _d->cache_file.reset();
+    _d->buildLookupTable();
 }
 
 uint16_t ObjectsDictionary::size() const { return _d->object_entries.size(); }
@@ -261,6 +459,49 @@ uint32_t ObjectsDictionary::productNumber() const  { return _d->product; }
 uint32_t ObjectsDictionary::revisionNumber() const { return _d->revision; }
 
 
+static const char* cppTypeName(TypeID type)
+{
+    switch( type )
+    {
+    case UINT8:   return "uint8_t";
+    case UINT16:  return "uint16_t";
+    case UINT32:  return "uint32_t";
+    case UINT64:  return "uint64_t";
+    case INT8:    return "int8_t";
+    case INT16:   return "int16_t";
+    case INT32:   return "int32_t";
+    case INT64:   return "int64_t";
+    case FLOAT32: return "float";
+    case FLOAT64: return "double";
+    default:      return NULL; // no typed descriptor for STRING and domains.
+    }
+}
+
+// The names of the entries contain "::" and parentheses.
+static std::string toIdentifier(const char* name)
+{
+    std::string identifier;
+    for( const char* c = name; *c != '\0'; c++ )
+    {
+        const bool valid = std::isalnum( static_cast<unsigned char>(*c) ) != 0;
+        if( valid )
+        {
+            identifier.push_back( *c );
+        }
+        else if( !identifier.empty() && identifier.back() != '_' )
+        {
+            identifier.push_back( '_' );
+        }
+    }
+    while( !identifier.empty() && identifier.back() == '_' ) identifier.pop_back();
+
+    if( !identifier.empty() && std::isdigit( static_cast<unsigned char>(identifier[0]) ) )
+    {
+        identifier.insert( 0, "Object_" );
+    }
+    return identifier;
+}
+
 void ObjectsDictionary::generateCode(const char* name)
 {
     std::ofstream  fout;
@@ -285,7 +526,36 @@ void ObjectsDictionary::generateCode(const char* name)
     fout << ind << class_name << "(); \n\n";
 
     indentLess(&ind);
-    fout << ind << "}; //end of class\n";
+    fout << ind << "}; //end of class\n\n";
+
+    // typed descriptors, with the key of the entry in this dictionary.
+    fout << ind << "/// Typed descriptors of the numeric objects of " << class_name << " (see ObjectRef).\n";
+    fout << ind << "namespace " << name << "_Objects {\n";
+    indentMore(&ind);
+
+    std::set<std::string> identifiers;
+    for(unsigned i=0; i< _d->object_entries.size(); i++)
+    {
+        const ObjectEntry& entry = _d->object_entries[i];
+        const char* type_name = cppTypeName( entry.type() );
+        if( !type_name ) continue;
+
+        std::string identifier = toIdentifier( entry.name() );
+        if( identifier.empty() || identifiers.count( identifier ) )
+        {
+            char suffix[16];
+            sprintf( suffix, "_%04X_%02X", entry.index(), entry.subindex() );
+            identifier = ( identifier.empty() ? std::string("Object") : identifier ) + suffix;
+        }
+        identifiers.insert( identifier );
+
+        fout << ind << "constexpr ObjectRef<0x" << std::hex << entry.index() << std::dec << ", "
+             << (int)entry.subindex() << ", " << type_name << ", " << i << "> "
+             << identifier << "{};\n";
+    }
+    indentLess(&ind);
+    fout << ind << "}\n";
+
     indentLess(&ind);
     fout << ind << "} //end of namespace\n\n";
     fout << ind << "#endif \n";
@@ -304,7 +574,7 @@ void ObjectsDictionary::generateCode(const char* name)
     fout << ind << "{\n";
     indentMore(&ind);
 
-    fout << ind << "this->_d->object_entries.reserve("<< _d->object_entries.size() << " );\n";
+    fout << ind << "this->reserve("<< _d->object_entries.size() << " );\n";
 
     for(unsigned i=0; i< _d->object_entries.size(); i++)
     {
@@ -338,6 +608,22 @@ void ObjectsDictionary::generateCode(const char* name)
 }
 
 
+static void parseEDSFile(ObjectsDictionary* dictionary, const char* filename)
+{
+    if( !std::ifstream( filename ).good() )
+    {
+        printf("problem loading %s \n", filename);
+        throw std::runtime_error("Problem loading EDS file" );
+    }
+    const std::string& cache_directory = CMI::get().dictionary_cache_directory;
+    dictionary->parseEDS( filename, cache_directory.empty() ? NULL : cache_directory.c_str() );
+}
+
+void setObjectDictionaryCacheDirectory(const char* directory)
+{
+    CMI::get().dictionary_cache_directory = directory ? directory : "";
+}
+
 ObjectsDictionaryPtr createObjectDictionary(const char* filename, const char* OD_name)
 {
 
@@ -347,17 +633,8 @@ ObjectsDictionaryPtr createObjectDictionary(const char* filename, const char* OD
         return CMI::get().object_dictionaries.at(OD_name);
     }
 
-    // create a file-reading object
-    std::ifstream fin;
-    fin.open(filename); // open a file
-    if (!fin.good())
-    {
-        printf("problem loading %s \n", filename);
-        throw std::runtime_error("Problem loading EDS file" );
-    }
-
     ObjectsDictionaryPtr od_ptr( new ObjectsDictionary );
-    od_ptr->parseEDS( fin );
+    parseEDSFile( od_ptr.get(), filename );
     CMI::get().object_dictionaries.insert( std::make_pair(OD_name, od_ptr ) );
 
     return od_ptr;
@@ -365,25 +642,17 @@ ObjectsDictionaryPtr createObjectDictionary(const char* filename, const char* OD
 
 ObjectsDictionaryPtr reloadObjectDictionary(const char* filename, const char* OD_name)
 {
-    std::ifstream fin;
-    fin.open(filename); // open a file
-    if (!fin.good())
-    {
-        printf("problem loading %s \n", filename);
-        throw std::runtime_error("Problem loading EDS file" );
-    }
-
     ObjectsDictionaryPtr od_ptr;
     if (CMI::get().object_dictionaries.find(OD_name) == CMI::get().object_dictionaries.end())
     {
         // not found. Allocate one
         od_ptr = ObjectsDictionaryPtr( new ObjectsDictionary );
-        od_ptr->parseEDS( fin );
+        parseEDSFile( od_ptr.get(), filename );
         CMI::get().object_dictionaries.insert( std::make_pair(OD_name, od_ptr ) );
     }
     else{
         od_ptr = CMI::get().object_dictionaries.at(OD_name);
-        od_ptr->parseEDS( fin );
+        parseEDSFile( od_ptr.get(), filename );
     }
     return od_ptr;
 }
@@ -410,176 +679,474 @@ const ObjectEntry& ObjectsDictionary::getEntry(ObjectKey const& key)
 }
 
 
-ObjectKey ObjectsDictionary::find(uint16_t index, uint8_t subindex)
+ObjectKey ObjectsDictionary::tryFind(uint16_t index, uint8_t subindex) const
 {
-    ObjectEntry entry_to_find( index,  subindex, ObjectEntry::RO, false, OTHER);
-    std::vector<ObjectEntry>::iterator it;
-
-    it = std::lower_bound (_d->object_entries.begin(), _d->object_entries.end(), entry_to_find, compareObjectEntries);
-
-    bool found = true;
-    if( it == _d->object_entries.end() )
+    const Impl::Span* span = _d->span( index );
+    if( !span )
     {
-        // printf("this is not there:  0x%X\n", entry_to_find.id().get() );
-        found = false;
+        return ObjectKey( NOT_FOUND );
     }
-    else if( it->id().get() !=  entry_to_find.id().get() )
+    // the subindexes are usually contiguous, starting from 0: try the direct hit first.
+    if( subindex < span->count && _d->object_entries[ span->first + subindex ].subindex() == subindex )
     {
-       // printf("DONT match: 0x%X  0x%X\n", it->id().get(), entry_to_find.id().get());
-        found = false;
+        return ObjectKey( span->first + subindex );
     }
-    if( !found)
+    // otherwise binary search: the entries of the span are sorted by subindex.
+    uint16_t first = span->first;
+    uint16_t count = span->count;
+    while( count > 0 )
     {
-        char temp[100];
-        sprintf(temp,"index/subindex pair 0x%X/0x%x not found in object dictionary\n", index, subindex);
-     //   printf("%s\n", temp);
-
-        throw std::runtime_error( temp );
+        const uint16_t half = count / 2;
+        if( _d->object_entries[ first + half ].subindex() < subindex )
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else{
+            count = half;
+        }
     }
-    return  ObjectKey( it - _d->object_entries.begin() );
-}
-
-std::string GetLine(std::ifstream & fin)
-{
-    char buffer[100];
-    fin.getline(buffer, 100);
-    return std::string(buffer);
+    if( first < span->first + span->count && _d->object_entries[first].subindex() == subindex )
+    {
+        return ObjectKey( first );
+    }
+    return ObjectKey( NOT_FOUND );
 }
 
-std::string GetLine(std::stringstream & fin)
+ObjectKey ObjectsDictionary::find(uint16_t index, uint8_t subindex)
 {
-    char buffer[100];
-    fin.getline(buffer, 100);
-    return std::string(buffer);
+    const ObjectKey key = tryFind( index, subindex );
+    if( key == ObjectKey( NOT_FOUND ) )
+    {
+        char temp[100];
+        sprintf(temp,"index/subindex pair 0x%X/0x%x not found in object dictionary\n", index, subindex);
+        throw std::runtime_error( temp );
+    }
+    return key;
 }
 
-bool lineIsObjectHeader(std::string const& line)
+void ObjectsDictionary::parseEDS(std::ifstream& fin)
 {
-    return ( line.find('[') != std::string::npos && line.find(']') != std::string::npos);
+    const std::string content( (std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>() );
+    parseEDS( content.data(), content.size() );
 }
 
-void ObjectsDictionary::parseEDS(std::ifstream& fin)
+void ObjectsDictionary::parseEDS(const char* text, size_t length)
 {
     // clean up just in case.
-    _d->object_entries.clear();
+    clear();
     _d->array_index_name.clear();
 
-    std::stringstream block;
-    std::string line =GetLine(fin);
+    std::string entry_name;
+    Variant     entry_default;
 
-    while (lineIsObjectHeader(line) == false && !fin.eof()) line =GetLine(fin);
+    BlockReader reader( text, text + length );
+    // whatever comes before the first header isn't part of any block.
+    reader.skipBlock();
 
-    while( !fin.eof() )
+    while( !reader.finished() )
     {
-        int num_lines = 0;
-        block.str(line);
-        do{
-            //clear the block
-            block << line << "\n";
-            num_lines++;
-            line =GetLine(fin);
-        }
-        while(lineIsObjectHeader(line) == false && !fin.eof() );
+        const StringView header = reader.header();
 
-        ObjectEntry new_entry = _d->parseBlock( block , num_lines) ;
+        entry_name.clear();
+        entry_default = Variant();
+        ObjectEntry new_entry = _d->parseBlock( header, reader, &entry_name, &entry_default ) ;
+        // parseBlock might return before the last line of the block.
+        reader.skipBlock();
 
         if(new_entry.type() != OTHER && new_entry.type() != ARRAY_INDEX )
         {
-            _d->object_entries.push_back( new_entry );
+            _d->append( new_entry, entry_name.c_str(), entry_default );
             //  printf("Added [0x%X / 0x%X]: \n", _d->object_entries.back().index(), _d->object_entries.back().subindex());
         }
     }
 
     // IMPORTANT sort at the end
     std::sort( _d->object_entries.begin(), _d->object_entries.end(), compareObjectEntries );
+    _d->buildLookupTable();
+}
+
+//------------------------------------------------------------------
+// Binary cache of a dictionary parsed from an EDS file.
+//
+// Layout: CacheHeader, num_entries x CacheEntry (sorted by id), names (null terminated strings).
+// Increase DICTIONARY_CACHE_VERSION every time the layout or the values of TypeID change:
+// caches written by a different version are ignored (and then rewritten).
+
+static const uint32_t DICTIONARY_CACHE_VERSION = 1;
+static const char     DICTIONARY_CACHE_MAGIC[8] = { 'C','M','I','-','O','D','\0','\0' };
+static const uint32_t CACHE_NO_NAME = 0xFFFFFFFF;
+
+struct CacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;   // different padding/endianness of the writer.
+    uint64_t eds_hash;
+    uint64_t eds_size;
+    uint32_t vendor;
+    uint32_t product;
+    uint32_t revision;
+    uint32_t num_entries;
+    uint32_t names_size;
+    uint32_t entry_size;
+};
+
+struct CacheEntry
+{
+    uint32_t id;
+    uint8_t  access_type;
+    uint8_t  mappable;
+    uint8_t  type;
+    uint8_t  default_type;  // OTHER if there isn't any default value.
+    uint32_t name_offset;   // CACHE_NO_NAME if there isn't any name.
+    uint8_t  default_value[8];
+};
+
+// The cache is read without any conversion: values out of range of the enums mean a corrupted file.
+static bool isCachedTypeValid(uint8_t type)
+{
+    switch( type )
+    {
+    case UINT8:   case UINT16:  case UINT32: case UINT64:
+    case INT8:    case INT16:   case INT32:  case INT64:
+    case FLOAT32: case FLOAT64: case STRING:
+    case ARRAY_INDEX: case OTHER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// It is only used to detect that the EDS changed. It consumes 8 bytes at a time,
+// otherwise it would take longer than loading the cache itself.
+static uint64_t hashEDS(const char* text, size_t length)
+{
+    const uint64_t PRIME = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ length;
+
+    size_t i = 0;
+    for( ; i + 8 <= length; i += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, text + i, 8 );
+        hash = ( hash ^ word ) * PRIME;
+        hash ^= hash >> 29;
+    }
+    for( ; i < length; i++ )
+    {
+        hash = ( hash ^ static_cast<uint8_t>( text[i] ) ) * PRIME;
+    }
+    return hash;
+}
+
+template <typename T> void storeBytes(const Variant& value, uint8_t* bytes)
+{
+    const T number = value.extract<T>();
+    memcpy( bytes, &number, sizeof(T) );
+}
+
+template <typename T> Variant loadBytes(const uint8_t* bytes)
+{
+    T number;
+    memcpy( &number, bytes, sizeof(T) );
+    return Variant( number );
+}
+
+// Only numbers: variantFromString never creates anything else.
+static bool variantToBytes(const Variant& value, uint8_t* bytes)
+{
+    memset( bytes, 0, 8 );
+    switch( value.getTypeID() )
+    {
+    case UINT8:   storeBytes<uint8_t>( value, bytes );   return true;
+    case UINT16:  storeBytes<uint16_t>( value, bytes );  return true;
+    case UINT32:  storeBytes<uint32_t>( value, bytes );  return true;
+    case UINT64:  storeBytes<uint64_t>( value, bytes );  return true;
+    case INT8:    storeBytes<int8_t>( value, bytes );    return true;
+    case INT16:   storeBytes<int16_t>( value, bytes );   return true;
+    case INT32:   storeBytes<int32_t>( value, bytes );   return true;
+    case INT64:   storeBytes<int64_t>( value, bytes );   return true;
+    case FLOAT32: storeBytes<float>( value, bytes );     return true;
+    case FLOAT64: storeBytes<double>( value, bytes );    return true;
+    default: return false;
+    }
+}
+
+static bool variantFromBytes(uint8_t type, const uint8_t* bytes, Variant* value)
+{
+    switch( type )
+    {
+    case UINT8:   *value = loadBytes<uint8_t>( bytes );   return true;
+    case UINT16:  *value = loadBytes<uint16_t>( bytes );  return true;
+    case UINT32:  *value = loadBytes<uint32_t>( bytes );  return true;
+    case UINT64:  *value = loadBytes<uint64_t>( bytes );  return true;
+    case INT8:    *value = loadBytes<int8_t>( bytes );    return true;
+    case INT16:   *value = loadBytes<int16_t>( bytes );   return true;
+    case INT32:   *value = loadBytes<int32_t>( bytes );   return true;
+    case INT64:   *value = loadBytes<int64_t>( bytes );   return true;
+    case FLOAT32: *value = loadBytes<float>( bytes );     return true;
+    case FLOAT64: *value = loadBytes<double>( bytes );    return true;
+    default: return false;
+    }
 }
 
-void RemoveSpaces(std::string &s)
+bool ObjectsDictionary::saveCache(const char* filename, uint64_t eds_hash, uint64_t eds_size) const
 {
-    size_t first;
+    std::vector<CacheEntry> entries( _d->object_entries.size() );
+    std::string names;
+
+    for( size_t i = 0; i < entries.size(); i++ )
+    {
+        const ObjectEntry& entry = _d->object_entries[i];
+        CacheEntry& out = entries[i];
+        memset( &out, 0, sizeof(out) );
+        out.id          = entry.id().get();
+        out.access_type = entry.access_type();
+        out.mappable    = entry.PDO_is_mapable();
+        out.type        = entry.type();
+        out.default_type = OTHER;
+        if( entry._default_value && variantToBytes( *entry._default_value, out.default_value ) )
+        {
+            out.default_type = entry._default_value->getTypeID();
+        }
+        out.name_offset = CACHE_NO_NAME;
+        if( entry._name && entry._name[0] != '\0' )
+        {
+            out.name_offset = static_cast<uint32_t>( names.size() );
+            names.append( entry._name ).push_back( '\0' );
+        }
+    }
+
+    CacheHeader header;
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, DICTIONARY_CACHE_MAGIC, sizeof(header.magic) );
+    header.version     = DICTIONARY_CACHE_VERSION;
+    header.header_size = sizeof(CacheHeader);
+    header.entry_size  = sizeof(CacheEntry);
+    header.eds_hash    = eds_hash;
+    header.eds_size    = eds_size;
+    header.vendor      = _d->vendor;
+    header.product     = _d->product;
+    header.revision    = _d->revision;
+    header.num_entries = static_cast<uint32_t>( entries.size() );
+    header.names_size  = static_cast<uint32_t>( names.size() );
+
+    // write a temporary file and rename it: a reader never sees half of a cache.
+    const std::string temp_filename = std::string(filename) + ".tmp" +
+            std::to_string( GetTimeNow().time_since_epoch().count() );
+    {
+        std::ofstream fout( temp_filename.c_str(), std::ios::binary | std::ios::trunc );
+        if( !fout.good() ) return false;
+
+        fout.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+        fout.write( reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CacheEntry) );
+        fout.write( names.data(), names.size() );
+        if( !fout.good() )
+        {
+            fout.close();
+            std::remove( temp_filename.c_str() );
+            return false;
+        }
+    }
+#ifdef WIN32
+    // unlike POSIX, rename fails if the destination exists.
+    if( MoveFileExA( temp_filename.c_str(), filename, MOVEFILE_REPLACE_EXISTING ) == 0 )
+#else
+    if( std::rename( temp_filename.c_str(), filename ) != 0 )
+#endif
+    {
+        std::remove( temp_filename.c_str() );
+        return false;
+    }
+    return true;
+}
+
+bool ObjectsDictionary::loadCache(const char* filename, uint64_t eds_hash, uint64_t eds_size)
+{
+    std::unique_ptr<MappedFile> file;
+    try{
+        file.reset( new MappedFile( filename ) );
+    }
+    catch( std::runtime_error& )
+    {
+        return false; // not created yet.
+    }
+
+    if( file->size() < sizeof(CacheHeader) ) return false;
+
+    CacheHeader header;
+    memcpy( &header, file->data(), sizeof(header) );
+
+    if( memcmp( header.magic, DICTIONARY_CACHE_MAGIC, sizeof(header.magic) ) != 0 ||
+        header.version     != DICTIONARY_CACHE_VERSION ||
+        header.header_size != sizeof(CacheHeader) ||
+        header.entry_size  != sizeof(CacheEntry) ||
+        header.eds_hash    != eds_hash ||
+        header.eds_size    != eds_size ||
+        header.num_entries > NOT_FOUND )
+    {
+        return false; // stale or written by a different version.
+    }
+
+    const size_t entries_size = header.num_entries * sizeof(CacheEntry);
+    if( file->size() != sizeof(CacheHeader) + entries_size + header.names_size )
+    {
+        return false; // truncated.
+    }
+
+    const CacheEntry* entries = reinterpret_cast<const CacheEntry*>( file->data() + sizeof(CacheHeader) );
+    const char* names = file->data() + sizeof(CacheHeader) + entries_size;
+
+    if( header.names_size > 0 && names[ header.names_size - 1 ] != '\0' ) return false;
 
-    //-------- remove certain elements -------
-    const std::string characters_to_remove(".:;/\\ -\"\'");
-    first = s.find_first_of(characters_to_remove);
-    while( first != std::string::npos)
+    for( uint32_t i = 0; i < header.num_entries; i++ )
     {
-        s.at(first) = '_';
-        first = s.find_first_of(characters_to_remove);
+        const CacheEntry& entry = entries[i];
+        if( ( i > 0 && entries[i-1].id >= entry.id ) ||
+            ( entry.name_offset != CACHE_NO_NAME && entry.name_offset >= header.names_size ) ||
+            entry.access_type > ObjectEntry::RW ||
+            !isCachedTypeValid( entry.type ) )
+        {
+            return false;
+        }
     }
 
-    //---- remove doubles  -------
-    first =  s.find("__");
-    while( first != std::string::npos)
+    //------------------------------------
+    // the cache is valid.
+    clear();
+    _d->vendor   = header.vendor;
+    _d->product  = header.product;
+    _d->revision = header.revision;
+    _d->object_entries.reserve( header.num_entries );
+
+    for( uint32_t i = 0; i < header.num_entries; i++ )
     {
-        s.erase(first,1);
-        first = s.find("__");
+        const CacheEntry& cached = entries[i];
+        ObjectEntry entry( (cached.id >> 8) & 0xFFFF, cached.id & 0xFF,
+                           static_cast<ObjectEntry::AccessType>( cached.access_type ),
+                           cached.mappable != 0,
+                           static_cast<TypeID>( cached.type ) );
+#ifndef EMBEDDED
+        // names aren't copied: they point to the mapping of the cache.
+        entry._name = ( cached.name_offset == CACHE_NO_NAME ) ? NULL : names + cached.name_offset;
+
+        Variant default_value;
+        if( variantFromBytes( cached.default_type, cached.default_value, &default_value ) )
+        {
+            _d->default_values.push_back( default_value );
+            entry._default_value = &_d->default_values.back();
+        }
+#endif
+        _d->object_entries.push_back( entry );
     }
+    _d->cache_file = std::move( file );
+    _d->buildLookupTable();
+    return true;
+}
 
-    first =  s.find_first_of("\r\0");
-    while( first != std::string::npos)
+void ObjectsDictionary::parseEDS(const char* filename, const char* cache_directory)
+{
+    MappedFile file( filename );
+    if( !cache_directory )
     {
-        s.erase(first,1);
-        first = s.find_first_of("\r\0");
+        parseEDS( file.data(), file.size() );
+        return;
     }
 
-    while (s.at( s.size()-1 )=='_') s.erase(s.size()-1,1);
+    // a different EDS with the same name just invalidates the cache (see the hash below).
+    const StringView path( filename );
+    const size_t separator = path.find_last_of( "/\\" );
+    const StringView name = ( separator == StringView::npos ) ? path : path.substr( separator + 1 );
+    const std::string cache_filename = std::string( cache_directory ) + "/" + std::string( name.data(), name.size() ) + ".cache";
+    const uint64_t hash = hashEDS( file.data(), file.size() );
+
+    if( loadCache( cache_filename.c_str(), hash, file.size() ) == false )
+    {
+        parseEDS( file.data(), file.size() );
+        if( saveCache( cache_filename.c_str(), hash, file.size() ) == false )
+        {
+            Log::SYS()->debug("can't write the cache of the dictionary {}", cache_filename );
+        }
+    }
 }
 
-void RemoveParameterName(std::string &s)
+// The characters that can't be part of an identifier become '_' (never two in a row,
+// never at the end), and '\r' is removed.
+void RemoveSpaces(StringView in, std::string* out)
 {
-    size_t pos = s.find('=');
+    static const StringView characters_to_remove(".:;/\\ -\"\'");
+
+    out->clear();
+    out->reserve( in.size() );
+    char previous = '\0';
+    for( char c: in )
+    {
+        if( characters_to_remove.find(c) != StringView::npos ) c = '_';
+        const bool repeated = ( c == '_' && previous == '_' );
+        previous = c;
+        if( !repeated && c != '\r' )  out->push_back(c);
+    }
+    while ( !out->empty() && out->back() =='_') out->pop_back();
+}
+
+// Split "Key=Value". Returns false if the line isn't a key/value pair.
+inline bool splitParameter(StringView line, StringView* key, StringView* value)
+{
+    const size_t pos = line.find('=');
+    if( pos == StringView::npos )
+    {
+        return false;
+    }
     if( pos == 0)
     {
-        throw std::runtime_error( std::string("no parameter name in EDS ") + s );
+        throw std::runtime_error( std::string("no parameter name in EDS ") + std::string(line) );
     }
-    s.erase(0, pos+1);
+    *key   = line.substr(0, pos);
+    *value = line.substr(pos+1);
+    return true;
 }
 
-ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_lines )
+ObjectEntry ObjectsDictionary::Impl::parseBlock(StringView header, BlockReader& lines, std::string* name, Variant* default_val )
 {
     uint16_t    entry_index    = 0;
     uint8_t     entry_subindex = 0;
     bool        entry_mappable = false;
     TypeID      entry_type( OTHER);
     ObjectEntry::AccessType  entry_access = ObjectEntry::CNST;
-    std::string entry_parameter_name;
-    Variant  default_val;
+    std::string& entry_parameter_name = *name;
 
     PRINTF("\n------------------------\n");
 
-    //first line is the header for sure
-    std::string line = GetLine(ss);
+    StringView line, key, value;
 
     size_t first_indx,last, first_sub;
     bool IS_SUB = false;
     bool IS_ARRAY_INDEX = false;
 
-    first_indx =  line.find('[')+1;
-    last       =  line.find(']')-1;
-    first_sub  = line.find("sub");
+    first_indx = header.find('[')+1;
+    last       = header.find(']')-1;
+    first_sub  = header.find("sub");
 
     //-------------------------------------------------
     // Parse the [DeviceInfo]
-    if( line.compare(0,12,"[DeviceInfo]") == 0)
+    if( absl::StartsWith( header, "[DeviceInfo]") )
     {
-
-        for (int i=0; i< num_lines-1; i++)
+        while( lines.next( &line ) )
         {
-            line = GetLine(ss);
-            if( line.find("VendorNumber=") != std::string::npos )
+            if( !splitParameter( line, &key, &value ) ) continue;
+
+            if( absl::EndsWith( key, "VendorNumber") )
             {
-                RemoveParameterName(line);
-                this->vendor = Variant(line).convert<uint32_t>();
+                this->vendor = NumberParser<uint32_t>(value);
             }
-            if( line.find("ProductNumber=") != std::string::npos )
+            if( absl::EndsWith( key, "ProductNumber") )
             {
-                RemoveParameterName(line);
-                this->product = Variant(line).convert<uint32_t>();
+                this->product = NumberParser<uint32_t>(value);
             }
-            if( line.find("RevisionNumber=") != std::string::npos )
+            if( absl::EndsWith( key, "RevisionNumber") )
             {
-                RemoveParameterName(line);
-                this->revision = Variant(line).convert<uint32_t>();
+                this->revision = NumberParser<uint32_t>(value);
             }
         }
         return ObjectEntry();
@@ -591,7 +1158,7 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
     //case 1: index only
 
     int obj_index =-1;
-    if ( first_sub !=  std::string::npos )
+    if ( first_sub !=  StringView::npos )
     {
         if ( (first_sub - first_indx) != 4 ) skip_block = true;
     }
@@ -602,24 +1169,21 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
 
     if( skip_block == false)
     {
-
-        obj_index =  NumberParserHex<unsigned>(line.substr(first_indx, first_indx+3)) ;
+        obj_index =  NumberParserHex<unsigned>(header.substr(first_indx, first_indx+3)) ;
     }
 
     if(obj_index <= 0 || skip_block)
     {
-        PRINTF("BLOCK skipped. Header: %s\n",line.c_str());
+        PRINTF("BLOCK skipped. Header: %s\n", std::string(header).c_str());
         return ObjectEntry();
     }
-    //std::cout << line << std::endl;
     PRINTF("-----------\nindex: 0x%X ( %d ) ", obj_index, obj_index);
 
     int subindex = 0;
-    if ( first_sub != std::string::npos)
+    if ( first_sub != StringView::npos)
     {
         IS_SUB = true;
-        std::string temp_s = line.substr( first_sub+3, last - first_sub-2 );
-        subindex = NumberParserHex<unsigned>( temp_s );
+        subindex = NumberParserHex<unsigned>( header.substr( first_sub+3, last - first_sub-2 ) );
         PRINTF("subindex: %d", subindex);
     }
     PRINTF("\n");
@@ -628,15 +1192,14 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
     entry_subindex = subindex;
     //---------------------------------------------------
 
-    for (int i=0; i< num_lines-1; i++)
+    while( lines.next( &line ) )
     {
-        line = GetLine(ss);
-        //   std::cout << "parsing line: " << line << std::endl;
+        if( !splitParameter( line, &key, &value ) ) continue;
 
-        if( line.find("SubNumber=") != std::string::npos &&  IS_SUB == false)
+        if( absl::EndsWith( key, "SubNumber") &&  IS_SUB == false)
         {
-            RemoveParameterName(line);
-            int sub_index_count = Variant(line).convert<int>();
+            // some EDS leave it empty.
+            int sub_index_count = trim(value).empty() ? 0 : NumberParser<int>(value);
 
             PRINTF(" SubNumber =  %d\n",  sub_index_count);
 
@@ -647,63 +1210,44 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
         }
         //-------------------------------------------------
 
-        if( line.find("ParameterName=") != std::string::npos)
+        else if( absl::EndsWith( key, "ParameterName") )
         {
 #ifndef EMBEDDED
-            RemoveParameterName(line);
-            RemoveSpaces(line);
+            std::string parameter;
+            RemoveSpaces( value, &parameter );
 
             if( IS_ARRAY_INDEX )
             {
-                array_index_name.insert( std::make_pair(entry_index, line ) );
+                array_index_name.insert( std::make_pair(entry_index, parameter ) );
             }
             else if(IS_SUB)
             {
                 entry_parameter_name = array_index_name[entry_index];
-                entry_parameter_name.append("::").append(line );
+                entry_parameter_name.append("::").append( parameter );
             }
             else{
-                entry_parameter_name = line;
+                entry_parameter_name = parameter;
             }
             PRINTF(" ParameterName = %s\n",entry_parameter_name.c_str());
 #endif
         }
 
         //-------------------------------------------------
-
-        if( line.find("ObjectType=") != std::string::npos)
-        {
-            RemoveParameterName(line );
-
-            PRINTF(" ObjectType =  %s\n",  line.c_str() );
-        }
-
-        //-------------------------------------------------
-        if( IS_ARRAY_INDEX == false)
+        else if( IS_ARRAY_INDEX == false)
         {
-            if( line.find("AccessType=") != std::string::npos)
+            if( absl::EndsWith( key, "AccessType") )
             {
-                RemoveParameterName(line );
-
-                std::locale loc;
-                for (char& c: line){
-                    c = std::toupper( c, loc);
-                }
-
-                if( line.find("RO") != std::string::npos)     entry_access = ObjectEntry::RO;
-                if( line.find("WO") != std::string::npos)     entry_access = ObjectEntry::WO;
-                if( line.find("RW") != std::string::npos)     entry_access = ObjectEntry::RW;
-                if( line.find("CONST") != std::string::npos)  entry_access = ObjectEntry::CNST;
+                if( containsIgnoreCase( value, "RO") )     entry_access = ObjectEntry::RO;
+                if( containsIgnoreCase( value, "WO") )     entry_access = ObjectEntry::WO;
+                if( containsIgnoreCase( value, "RW") )     entry_access = ObjectEntry::RW;
+                if( containsIgnoreCase( value, "CONST") )  entry_access = ObjectEntry::CNST;
                 PRINTF(" AccessType =  %d\n",  entry_access);
-
             }
             //-------------------------------------------------
 
-            if( line.find("DataType=") != std::string::npos)
+            else if( absl::EndsWith( key, "DataType") )
             {
-                std::string prev = line;
-                RemoveParameterName(line );
-                int raw_type =  Variant(line).convert<int>() ;
+                int raw_type =  NumberParser<int>(value) ;
 
                 // see http://ms10.at.tut.by/eds.html
                 entry_type = convert_EDS_Types(raw_type);
@@ -720,25 +1264,20 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
             }
             //-------------------------------------------------
 
-            if( line.find("DefaultValue=") != std::string::npos)
+            else if( absl::EndsWith( key, "DefaultValue") )
             {
-
 #ifndef EMBEDDED
-                RemoveParameterName(line );
-                if( line.size() > 0)
+                if( trim(value).size() > 0)
                 {
-                    default_val = variantFromString(entry_type, line);
+                    *default_val = variantFromString(entry_type, value);
                 }
 #endif
-                /*printf(" DefaultValue =  %s  -> %s -> %d  -> 0x%X\n",  line.c_str() , default_val.convert<std::string>().c_str(),
-                        default_val.convert<int>(), default_val.convert<int>() );*/
             }
             //-------------------------------------------------
-            if( line.find("PDOMapping=") != std::string::npos)
+            else if( absl::EndsWith( key, "PDOMapping") )
             {
-                RemoveParameterName(line );
-                entry_mappable= Variant(line).convert<bool>();
-                PRINTF(" PDOMapping =  %d (line was %s)\n", entry_mappable, line.c_str() );
+                entry_mappable = trim(value).empty() ? false : NumberParser<bool>(value);
+                PRINTF(" PDOMapping =  %d\n", entry_mappable );
             }
         }
     }
@@ -748,13 +1287,11 @@ ObjectEntry ObjectsDictionary::Impl::parseBlock(std::stringstream & ss, int num_
 #ifdef EMBEDDED
         return ObjectEntry();
 #else
-        return ObjectEntry(entry_index, 0, ObjectEntry::CNST, 0, ARRAY_INDEX, entry_parameter_name.c_str());
+        return ObjectEntry(entry_index, 0, ObjectEntry::CNST, 0, ARRAY_INDEX);
 #endif
     }
     return ObjectEntry(entry_index, entry_subindex,
-                       entry_access, entry_mappable, entry_type,
-                       entry_parameter_name.c_str(),
-                       default_val);
+                       entry_access, entry_mappable, entry_type);
 }
 
 Minimal_CANopen_Dictionary::Minimal_CANopen_Dictionary()
@@ -0,0 +1,39 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool>   armed(false);
+static std::atomic<size_t> allocations(0);
+
+void* operator new(std::size_t size)
+{
+    if( armed.load( std::memory_order_relaxed ) )
+    {
+        allocations++;
+    }
+    void* ptr = std::malloc( size ? size : 1 );
+    if( !ptr ) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free( ptr );
+}
+
+AllocationCounter::AllocationCounter()
+{
+    allocations = 0;
+    armed = true;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    armed = false;
+}
+
+size_t AllocationCounter::count() const
+{
+    return allocations.load();
+}
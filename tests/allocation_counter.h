@@ -0,0 +1,21 @@
+#ifndef CMI_TESTS_ALLOCATION_COUNTER_H
+#define CMI_TESTS_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts the heap allocations of the whole process (operator new is replaced in allocation_counter.cpp),
+// but only while an instance is alive: the allocations of the rest of the test executable are ignored.
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    size_t count() const;
+
+private:
+    AllocationCounter(const AllocationCounter&);
+    AllocationCounter& operator=(const AllocationCounter&);
+};
+
+#endif // CMI_TESTS_ALLOCATION_COUNTER_H
@@ -0,0 +1,74 @@
+#include "catch.hpp"
+#include "OS/AsyncManager.h"
+#include "allocation_counter.h"
+#include <atomic>
+#include <vector>
+
+using namespace CanMoveIt;
+
+// push count tasks and wait until all of them have been executed.
+static void runTasks(AsyncManager& manager, std::atomic<int>& counter, int count)
+{
+    const int target = counter.load() + count;
+    for (int i=0; i<count; i++)
+    {
+        manager.addImmediateTask( [&counter]() { counter++; } );
+    }
+    while( counter.load() < target )
+    {
+        std::this_thread::yield();
+    }
+}
+
+TEST_CASE( "addImmediateTask doesn't allocate in steady state", "[AsyncManager]" )
+{
+    AsyncManager manager( 0 );
+    std::atomic<int> counter(0);
+
+    // the first handlers let asio create its per-thread structures.
+    runTasks( manager, counter, 100 );
+
+    size_t allocations = 0;
+    {
+        AllocationCounter counted;
+        for (int r=0; r<100; r++ )
+        {
+            runTasks( manager, counter, 500 );
+        }
+        allocations = counted.count();
+    }
+
+    REQUIRE( counter.load() == 100 + 100*500 );
+    REQUIRE( allocations == 0 );
+}
+
+TEST_CASE( "addImmediateTask keeps the order when the ring overflows", "[AsyncManager]" )
+{
+    AsyncManager manager( AsyncManager::NO_OWN_THREAD{} );
+    std::vector<int> executed;
+    executed.reserve( 5000 );
+
+    for (int i=0; i<5000; i++)
+    {
+        manager.addImmediateTask( [&executed, i]() { executed.push_back(i); } );
+    }
+    manager.flush_expired();
+
+    REQUIRE( executed.size() == 5000 );
+    for (int i=0; i<5000; i++)
+    {
+        REQUIRE( executed[i] == i );
+    }
+}
+
+TEST_CASE( "AsyncManager can be destroyed with pending tasks", "[AsyncManager]" )
+{
+    int executed = 0;
+    {
+        AsyncManager manager( AsyncManager::NO_OWN_THREAD{} );
+        manager.addImmediateTask( [&executed]() { executed++; } );
+        manager.kill();
+        // the DrainHandler still queued in the io_service is destroyed together with it.
+    }
+    REQUIRE( executed == 0 );
+}
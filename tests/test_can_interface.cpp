@@ -0,0 +1,65 @@
+#include "catch.hpp"
+#include "virtual_bus.h"
+#include "allocation_counter.h"
+#include "cmi/CAN_Interface.h"
+
+using namespace CanMoveIt;
+
+// send frames to the interface, that answers each of them; wait for all the answers.
+static bool exchangeFrames(CANPortPtr& peer, std::atomic<int>& answers, int count)
+{
+    const int target = answers.load() + count;
+    CanMessage msg;
+    msg.cob_id = 0x181;
+    msg.len    = 8;
+    for (int i=0; i<count; i++ )
+    {
+        msg.data[0] = static_cast<uint8_t>( i );
+        peer->send( &msg );
+    }
+    return waitFor( answers, target );
+}
+
+TEST_CASE( "the frames received and sent by CanInterface don't allocate in steady state", "[CanInterface]" )
+{
+    CANPortPtr port, peer;
+    openVirtualBus( "test_can_interface_alloc", &port, &peer );
+
+    std::atomic<int> answers(0);
+    absl::any sub = peer->subscribeCallback( [&](const CanMessage&) { answers++; }, 0x7FF, 0x201 );
+
+    // msgReceivedCallback_Sync -> task of the executor -> interpreter -> pushMessage -> trySendMessage.
+    std::unique_ptr<CanInterface> device( new CanInterface( port, 300, 0x181, 0x7FF ) );
+    CanInterface* iface = device.get();
+    device->addReadInterpreter( [iface](const CanMessage& m)
+    {
+        CanMessage answer;
+        answer.cob_id  = 0x201;
+        answer.len     = 1;
+        answer.data[0] = m.data[0];
+        iface->pushMessage( answer );
+        return true;
+    });
+
+    // the first frames let the executor and the driver create their structures.
+    REQUIRE( exchangeFrames( peer, answers, 200 ) );
+
+    bool all_answered = true;
+    size_t allocations = 0;
+    {
+        AllocationCounter counted;
+        for (int r=0; r<20 && all_answered; r++ )
+        {
+            all_answered = exchangeFrames( peer, answers, 100 );
+        }
+        allocations = counted.count();
+    }
+    REQUIRE( all_answered );
+    REQUIRE( allocations == 0 );
+
+    // as in CMI::~CMI, the executor of the port is stopped before the interface is destroyed.
+    peer->unsubscribeCallback( sub );
+    peer->close();
+    port->close();
+    device.reset();
+}
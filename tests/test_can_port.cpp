@@ -0,0 +1,111 @@
+#include "catch.hpp"
+#include "virtual_bus.h"
+
+using namespace CanMoveIt;
+
+static void sendFrame(CANPortPtr& port, uint16_t cob_id)
+{
+    CanMessage msg;
+    msg.cob_id = cob_id;
+    msg.len    = 0;
+    port->send( &msg );
+}
+
+TEST_CASE( "unsubscribeCallback doesn't deadlock with callbacks that subscribe", "[CANPort]" )
+{
+    CANPortPtr receiver, sender;
+    openVirtualBus( "test_subscribe_from_callback", &receiver, &sender );
+
+    const CanRcvCallback dummy = [](const CanMessage&) {};
+    std::atomic<int> received(0);
+
+    absl::any sub = receiver->subscribeCallback( [&](const CanMessage&)
+    {
+        absl::any id = receiver->subscribeCallback( dummy, 0x7FF, 0x281 );
+        receiver->unsubscribeCallback( id );
+        received++;
+    }, 0x7FF, 0x181 );
+
+    std::atomic<bool> stop( false );
+    std::thread churn_thread( [&]()
+    {
+        while( !stop )
+        {
+            absl::any id = receiver->subscribeCallback( dummy, 0x7FF, 0x381 );
+            receiver->unsubscribeCallback( id );
+        }
+    });
+
+    const int FRAMES = 500;
+    bool all_received = true;
+    for (int i=0; i<FRAMES && all_received; i++ )
+    {
+        sendFrame( sender, 0x181 );
+        all_received = waitFor( received, i+1 );
+    }
+    stop = true;
+    churn_thread.join();
+
+    REQUIRE( all_received );
+    receiver->unsubscribeCallback( sub );
+    sender->close();
+    receiver->close();
+}
+
+TEST_CASE( "the callback isn't executed after unsubscribeCallback returned", "[CANPort]" )
+{
+    CANPortPtr receiver, sender;
+    openVirtualBus( "test_unsubscribe", &receiver, &sender );
+
+    std::atomic<int> received(0);
+    std::atomic<bool> unsubscribed( false );
+    std::atomic<bool> late_call( false );
+
+    absl::any sub = receiver->subscribeCallback( [&](const CanMessage&)
+    {
+        if( unsubscribed ) late_call = true;
+        received++;
+    }, 0x7FF, 0x181 );
+
+    for (int i=0; i<100; i++ ) { sendFrame( sender, 0x181 ); }
+    REQUIRE( waitFor( received, 1 ) );
+
+    receiver->unsubscribeCallback( sub );
+    unsubscribed = true;
+
+    // these frames are discarded.
+    std::atomic<int> other(0);
+    absl::any marker = receiver->subscribeCallback( [&](const CanMessage&) { other++; }, 0x7FF, 0x182 );
+    sendFrame( sender, 0x181 );
+    sendFrame( sender, 0x182 );
+    REQUIRE( waitFor( other, 1 ) );
+
+    REQUIRE( !late_call );
+    receiver->unsubscribeCallback( marker );
+    sender->close();
+    receiver->close();
+}
+
+TEST_CASE( "a port served by the receive reactor can be closed by its callback", "[CANPort]" )
+{
+    // the ports opened after this call (also by the other tests) use the reactor.
+    enableCanReceiveReactor( 1 );
+
+    CANPortPtr receiver, sender;
+    openVirtualBus( "test_reactor_close", &receiver, &sender );
+
+    std::atomic<int> closed(0);
+    receiver->subscribeCallback( [&](const CanMessage&)
+    {
+        if( closed == 0 )
+        {
+            receiver->close();
+            closed++;
+        }
+    }, 0x7FF, 0x181 );
+
+    sendFrame( sender, 0x181 );
+    REQUIRE( waitFor( closed, 1 ) );
+    REQUIRE( !receiver->is_open() );
+    sender->close();
+}
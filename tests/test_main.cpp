@@ -0,0 +1,4 @@
+#define CATCH_CONFIG_MAIN
+// the alternate signal stack of Catch 1.x doesn't compile with recent glibc (SIGSTKSZ isn't a constant).
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
+#include "catch.hpp"
@@ -0,0 +1,36 @@
+#include "catch.hpp"
+#include "cmi/ObjectDictionary.h"
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace CanMoveIt;
+
+static bool fileExists(const std::string& filename)
+{
+    return std::ifstream( filename.c_str() ).good();
+}
+
+TEST_CASE( "the dictionary cache is written only in the directory chosen by the user", "[ObjectDictionary]" )
+{
+    char directory[] = "/tmp/cmi_test_cacheXXXXXX";
+    REQUIRE( mkdtemp( directory ) != NULL );
+    const std::string eds_cache   = std::string( TEST_EDS_FILE ) + ".cache";
+    const std::string cache       = std::string( directory ) + "/ingenia_venus.eds.cache";
+
+    createObjectDictionary( TEST_EDS_FILE, "test_cache_disabled" );
+    REQUIRE_FALSE( fileExists( eds_cache ) );
+    REQUIRE_FALSE( fileExists( cache ) );
+
+    setObjectDictionaryCacheDirectory( directory );
+    ObjectsDictionaryPtr written = createObjectDictionary( TEST_EDS_FILE, "test_cache_written" );
+    ObjectsDictionaryPtr loaded  = createObjectDictionary( TEST_EDS_FILE, "test_cache_loaded" );
+    setObjectDictionaryCacheDirectory( NULL );
+
+    REQUIRE_FALSE( fileExists( eds_cache ) );
+    REQUIRE( fileExists( cache ) );
+    REQUIRE( loaded->size() == written->size() );
+
+    unlink( cache.c_str() );
+    rmdir( directory );
+}
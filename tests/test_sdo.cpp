@@ -0,0 +1,478 @@
+#include "catch.hpp"
+#include "virtual_bus.h"
+#include "cmi/CO301_interface.h"
+#include <functional>
+#include <mutex>
+#include <vector>
+
+using namespace CanMoveIt;
+
+static const uint8_t NODE = 1;
+
+// The answers of the slave to an SDO request of the master (none, one or more frames).
+typedef std::function<void(const CanMessage& request, std::vector<CanMessage>* answers)> SdoServer;
+
+static absl::any serveSdo(CANPortPtr& slave, SdoServer server)
+{
+    CANPort* port = slave.get();
+    return slave->subscribeCallback( [port, server](const CanMessage& request)
+    {
+        std::vector<CanMessage> answers;
+        server( request, &answers );
+        for( size_t i = 0; i < answers.size(); i++ )
+        {
+            // like on a real bus, the master has the time to send other frames in the meantime.
+            if( i > 0 ) std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+            port->send( &answers[i] );
+        }
+    }, 0x7FF, SDO_RX + NODE );
+}
+
+static CanMessage sdoAnswer(const CanMessage& request, uint8_t command, uint32_t value = 0)
+{
+    CanMessage answer;
+    answer.cob_id  = SDO_TX + NODE;
+    answer.len     = 8;
+    answer.data[0] = command;
+    answer.data[1] = request.data[1];
+    answer.data[2] = request.data[2];
+    answer.data[3] = request.data[3];
+    for (int i=0; i<4; i++ ) { answer.data[4+i] = (value >> (8*i)) & 0xFF; }
+    return answer;
+}
+
+static ObjectsDictionaryPtr testDictionary()
+{
+    ObjectsDictionaryPtr od = getObjectDictionary( "test_sdo" );
+    if( !od )
+    {
+        od = createObjectDictionary( TEST_EDS_FILE, "test_sdo" );
+    }
+    return od;
+}
+
+static bool ready(std::future<SdoResult>& reply)
+{
+    return reply.wait_for( std::chrono::seconds(2) ) == std::future_status::ready;
+}
+
+// As in CMI::~CMI, the executor of the port is stopped before the interface is destroyed.
+static void shutdown(CANPortPtr& master, CANPortPtr& slave, absl::any& sub, CO301_InterfacePtr& co301)
+{
+    slave->unsubscribeCallback( sub );
+    slave->close();
+    master->close();
+    co301.reset();
+}
+
+TEST_CASE( "sdoReadAsync isn't completed by the answer of sdoObjectRequest", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_read_async", &master, &slave );
+
+    // every upload returns a new value.
+    std::atomic<int> uploads(0);
+    absl::any sub = serveSdo( slave, [&](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        if( (request.data[0] >> 5) == 2 )
+        {
+            answers->push_back( sdoAnswer( request, 0x43, ++uploads ) );
+        }
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 200 ) );
+    const ObjectKey key = co301->findObjectKey( 0x1000, 0 );
+
+    co301->sdoObjectRequest( key );
+    std::future<SdoResult> reply = co301->sdoReadAsync( key );
+
+    REQUIRE( ready( reply ) );
+    SdoResult result = reply.get();
+    REQUIRE( result.status == DS_NEW_DATA );
+    REQUIRE( result.value.convert<uint32_t>() == 2 );
+
+    shutdown( master, slave, sub, co301 );
+}
+
+TEST_CASE( "sdoWriteAsync forgets the transaction when the value can't be sent", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_write_async", &master, &slave );
+
+    absl::any sub = serveSdo( slave, [&](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        if( (request.data[0] >> 5) == 1 )
+        {
+            answers->push_back( sdoAnswer( request, 0x60 ) );
+        }
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 201 ) );
+    const ObjectKey key = co301->findObjectKey( 0x1017, 0 );
+
+    // a string isn't converted to UINT16.
+    REQUIRE_THROWS( co301->sdoWriteAsync( key, Variant( std::string("abc") ) ) );
+
+    std::future<SdoResult> reply = co301->sdoWriteAsync( key, 100 );
+    REQUIRE( ready( reply ) );
+    REQUIRE( reply.get().status == DS_NEW_DATA );
+
+    shutdown( master, slave, sub, co301 );
+}
+
+// Block upload (CiA 301) of data, without CRC. The requests that aren't part of the block
+// transfer are recorded in other_requests, with the number of blocks acknowledged at that time.
+struct BlockUploadServer
+{
+    std::string       data;
+    std::atomic<int>  acks;
+    std::vector<int>  other_requests;
+    std::mutex        mutex;
+
+    BlockUploadServer(const std::string& d): data(d), acks(0) {}
+
+    void operator()(const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        const uint8_t ccs = request.data[0] >> 5;
+        if( ccs != 5 )
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            other_requests.push_back( acks );
+            if( ccs == 2 )
+            {
+                answers->push_back( sdoAnswer( request, 0x43, 1 ) );
+            }
+            return;
+        }
+        switch( request.data[0] & 0x03 )
+        {
+        case 0: // initiate: size indicated, no CRC.
+            answers->push_back( sdoAnswer( request, 0xC2, static_cast<uint32_t>( data.size() ) ) );
+            break;
+        case 3: // start: all the segments in a single block.
+        {
+            const size_t segments = (data.size() + 6) / 7;
+            for( size_t seqno = 1; seqno <= segments; seqno++ )
+            {
+                CanMessage segment;
+                segment.cob_id  = SDO_TX + NODE;
+                segment.len     = 8;
+                segment.data[0] = static_cast<uint8_t>( seqno | (seqno == segments ? 0x80 : 0) );
+                for( size_t i = 0; i < 7; i++ )
+                {
+                    const size_t pos = (seqno-1)*7 + i;
+                    segment.data[1+i] = pos < data.size() ? data[pos] : 0;
+                }
+                answers->push_back( segment );
+            }
+        }break;
+        case 2: // ack: end of the transfer.
+        {
+            acks++;
+            CanMessage end;
+            end.cob_id  = SDO_TX + NODE;
+            end.len     = 8;
+            end.data[0] = static_cast<uint8_t>( 0xC1 | (((7 - data.size() % 7) % 7) << 2) );
+            answers->push_back( end );
+        }break;
+        default: break; // end
+        }
+    }
+};
+
+TEST_CASE( "the SDO requests aren't sent in the middle of a block upload", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_block_upload", &master, &slave );
+
+    std::shared_ptr<BlockUploadServer> server = std::make_shared<BlockUploadServer>( "block upload of 33 bytes of data" );
+    absl::any sub = serveSdo( slave, [server](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        (*server)( request, answers );
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 202 ) );
+    co301->setReadTimeout( Milliseconds(100) );
+
+    std::promise<SdoResult> block_result;
+    co301->sdoBlockUploadAsync( co301->findObjectKey( 0x1008, 0 ),
+                                [&](const SdoResult& result) { block_result.set_value( result ); }, false );
+    std::future<SdoResult> reply = co301->sdoReadAsync( co301->findObjectKey( 0x1000, 0 ) );
+
+    std::future<SdoResult> block_reply = block_result.get_future();
+    REQUIRE( ready( block_reply ) );
+    SdoResult result = block_reply.get();
+    REQUIRE( result.status == DS_NEW_DATA );
+    REQUIRE( result.value.extract<std::string>() == server->data );
+
+    REQUIRE( ready( reply ) );
+    REQUIRE( reply.get().status == DS_NEW_DATA );
+    {
+        std::lock_guard<std::mutex> lock( server->mutex );
+        REQUIRE( server->other_requests.size() == 1 );
+        REQUIRE( server->other_requests[0] == 1 );
+    }
+
+    shutdown( master, slave, sub, co301 );
+}
+
+TEST_CASE( "the timeout of another SDO request doesn't abort the block upload", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_block_timeout", &master, &slave );
+
+    std::shared_ptr<BlockUploadServer> server = std::make_shared<BlockUploadServer>( "block upload" );
+    absl::any sub = serveSdo( slave, [server](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        // the upload of 0x1017 is never answered.
+        if( (request.data[0] >> 5) == 2 && request.data[1] == 0x17 ) return;
+        (*server)( request, answers );
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 203 ) );
+    co301->setReadTimeout( Milliseconds(50) );
+
+    std::future<SdoResult> reply = co301->sdoReadAsync( co301->findObjectKey( 0x1017, 0 ) );
+
+    std::promise<SdoResult> block_result;
+    co301->sdoBlockUploadAsync( co301->findObjectKey( 0x1008, 0 ),
+                                [&](const SdoResult& result) { block_result.set_value( result ); }, false );
+
+    REQUIRE( ready( reply ) );
+    REQUIRE( reply.get().status == DS_TIMEOUT );
+
+    std::future<SdoResult> block_reply = block_result.get_future();
+    REQUIRE( ready( block_reply ) );
+    REQUIRE( block_reply.get().status == DS_NEW_DATA );
+
+    shutdown( master, slave, sub, co301 );
+}
+
+TEST_CASE( "an NMT state change doesn't overtake the SDO requests queued before it", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_nmt_order", &master, &slave );
+
+    std::mutex mutex;
+    std::vector<uint16_t> received;
+    std::atomic<int> nmt(0);
+
+    absl::any sub = serveSdo( slave, [&](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            received.push_back( request.cob_id );
+        }
+        // a slow answer: the NMT command is pushed while the queue waits for it.
+        std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+        answers->push_back( sdoAnswer( request, 0x43, 1 ) );
+    });
+    absl::any nmt_sub = slave->subscribeCallback( [&](const CanMessage& request)
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            received.push_back( request.cob_id );
+        }
+        nmt++;
+    }, 0x7FF, NMT );
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 204 ) );
+    co301->sdoObjectRequest( co301->findObjectKey( 0x1000, 0 ) );
+    co301->sdoObjectRequest( co301->findObjectKey( 0x1017, 0 ) );
+    co301->sendNMT_stateChange( NMT_PRE_OPERATIONAL );
+
+    REQUIRE( waitFor( nmt, 1 ) );
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        REQUIRE( received.size() == 3 );
+        REQUIRE( received[0] == SDO_RX + NODE );
+        REQUIRE( received[1] == SDO_RX + NODE );
+        REQUIRE( received[2] == NMT );
+    }
+
+    slave->unsubscribeCallback( nmt_sub );
+    shutdown( master, slave, sub, co301 );
+}
+
+TEST_CASE( "fast answers don't shorten the read timeout unless the adaptive timeout is enabled", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_read_timeout", &master, &slave );
+
+    absl::any sub = serveSdo( slave, [&](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        answers->push_back( sdoAnswer( request, 0x43, 1 ) );
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 205 ) );
+    const ObjectKey key = co301->findObjectKey( 0x1000, 0 );
+    for( int i = 0; i < 8; i++ )
+    {
+        std::future<SdoResult> reply = co301->sdoReadAsync( key );
+        REQUIRE( ready( reply ) );
+    }
+    REQUIRE( co301->getRttStatistics().num_samples > 0 );
+    REQUIRE( co301->getReadTimeout() == Milliseconds(200) );
+
+    // the round trip time is updated after the answer is delivered.
+    co301->setAdaptiveReadTimeout( Milliseconds(5), Milliseconds(200) );
+    const TimePoint deadline = GetTimeNow() + std::chrono::seconds(2);
+    while( co301->getReadTimeout() == Milliseconds(200) && GetTimeNow() < deadline )
+    {
+        std::future<SdoResult> reply = co301->sdoReadAsync( key );
+        REQUIRE( ready( reply ) );
+    }
+    REQUIRE( co301->getReadTimeout() < Milliseconds(200) );
+
+    shutdown( master, slave, sub, co301 );
+}
+
+TEST_CASE( "tryFindObjectKey finds the entry with key 0xFF", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_try_find", &master, &slave );
+
+    ObjectsDictionaryPtr od = testDictionary();
+    REQUIRE( od->size() > 0xFF );
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, od, 206 ) );
+
+    const ObjectID id = od->getEntry( ObjectKey(0xFF) ).id();
+    REQUIRE( co301->tryFindObjectKey( id ) == ObjectKey(0xFF) );
+    REQUIRE( co301->tryFindObjectKey( ObjectID( 0x0001, 0xFF ) ) == ObjectKey(ObjectsDictionary::NOT_FOUND) );
+
+    slave->close();
+    master->close();
+    co301.reset();
+}
+
+// Slave for CO301_Interface::init: the TPDOs are disabled (CiA 301 default COB-IDs) and the COB-ID of
+// the second TPDO can't be read, although its mapping (0x6064) can.
+static void pdoConfigServer(const CanMessage& request, std::vector<CanMessage>* answers)
+{
+    const uint8_t  ccs   = request.data[0] >> 5;
+    const uint16_t index = request.data[1] | (request.data[2] << 8);
+    const uint8_t  sub   = request.data[3];
+    if( ccs == 1 )
+    {
+        answers->push_back( sdoAnswer( request, 0x60 ) );
+        return;
+    }
+    if( ccs != 2 ) return;
+
+    if( index == 0x1801 && sub == 1 )
+    {
+        answers->push_back( sdoAnswer( request, 0x80, 0x08000000 ) );
+    }
+    else if( index >= 0x1400 && index < 0x1A00 && sub == 1 )
+    {
+        const uint32_t base = ( index >= 0x1800 ) ? 0x180 : 0x200;
+        answers->push_back( sdoAnswer( request, 0x43, 0x80000000 | ( base + 0x100*(index & 0xFF) + NODE ) ) );
+    }
+    else if( index == 0x1A01 )
+    {
+        answers->push_back( sdoAnswer( request, 0x43, sub == 0 ? 1 : 0x60640020 ) );
+    }
+    else{
+        answers->push_back( sdoAnswer( request, 0x43, index == 0x1000 ? 0x20192 : 0 ) );
+    }
+}
+
+static void sendInt32(CANPortPtr& port, uint16_t cob_id, int32_t value)
+{
+    CanMessage msg;
+    msg.cob_id = cob_id;
+    msg.len    = 4;
+    memcpy( msg.data, &value, 4 );
+    port->send( &msg );
+}
+
+TEST_CASE( "the PDOs that are disabled or have an unknown COB-ID aren't decoded", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_pdo_decoder", &master, &slave );
+    absl::any sub = serveSdo( slave, pdoConfigServer );
+
+    testDictionary();
+    CO301_InterfacePtr co301 = create_CO301_Interface( master, NODE, "test_sdo", 207 );
+    const ObjectKey position = co301->findObjectKey( 0x6064, 0 );
+    const ObjectKey velocity = co301->findObjectKey( 0x606C, 0 );
+
+    PDO_MappingList position_mapping, velocity_mapping;
+    position_mapping.push_back( ObjectID( 0x6064, 0 ) );
+    velocity_mapping.push_back( ObjectID( 0x606C, 0 ) );
+    co301->pdoMapping( PDO1_TX, position_mapping, 0x180 + NODE );
+    co301->pdoMapping( PDO3_TX, velocity_mapping, 0x380 + NODE );
+    REQUIRE( co301->waitQueueEmpty( Milliseconds(1000) ) );
+
+    // the frames are decoded in order: once velocity is updated, the frame sent before it was processed.
+    int32_t sync = 0;
+    auto decodeUntil = [&](int32_t value) -> bool
+    {
+        sendInt32( slave, 0x380 + NODE, value );
+        const TimePoint deadline = GetTimeNow() + std::chrono::seconds(2);
+        while( co301->getLastObjectReceived( velocity, &sync ), sync != value )
+        {
+            if( GetTimeNow() > deadline ) return false;
+            std::this_thread::yield();
+        }
+        return true;
+    };
+    int32_t value = 0;
+
+    sendInt32( slave, 0x180 + NODE, 5 );
+    REQUIRE( decodeUntil( 1 ) );
+    co301->getLastObjectReceived( position, &value );
+    REQUIRE( value == 5 );
+
+    // without its COB-ID, the second TPDO used to be decoded from the COB-ID equal to the node id.
+    sendInt32( slave, NODE, 7 );
+    REQUIRE( decodeUntil( 2 ) );
+    co301->getLastObjectReceived( position, &value );
+    REQUIRE( value == 5 );
+
+    co301->pdoEnableComm( PDO1_TX, false );
+    sendInt32( slave, 0x180 + NODE, 9 );
+    REQUIRE( decodeUntil( 3 ) );
+    co301->getLastObjectReceived( position, &value );
+    REQUIRE( value == 5 );
+
+    slave->unsubscribeCallback( sub );
+    slave->close();
+    master->close();
+    co301.reset();
+    remove_CO301_Interface( 207 );
+}
+
+TEST_CASE( "the master aborts a segmented upload when the segment isn't answered", "[SDO]" )
+{
+    CANPortPtr master, slave;
+    openVirtualBus( "test_sdo_segment_timeout", &master, &slave );
+
+    std::atomic<int>      aborts(0);
+    std::atomic<uint32_t> abort_code(0);
+    absl::any sub = serveSdo( slave, [&](const CanMessage& request, std::vector<CanMessage>* answers)
+    {
+        const uint8_t ccs = request.data[0] >> 5;
+        if( ccs == 2 ) // initiate: segmented, 20 bytes. The segments are never sent.
+        {
+            answers->push_back( sdoAnswer( request, 0x41, 20 ) );
+        }
+        else if( ccs == 4 )
+        {
+            abort_code = request.data[4] | (request.data[5] << 8) | (request.data[6] << 16) |
+                         (static_cast<uint32_t>(request.data[7]) << 24);
+            aborts++;
+        }
+    });
+
+    CO301_InterfacePtr co301( new CO301_Interface( master, NODE, testDictionary(), 208 ) );
+    co301->setReadTimeout( Milliseconds(50) );
+
+    std::future<SdoResult> reply = co301->sdoReadAsync( co301->findObjectKey( 0x1008, 0 ) );
+    REQUIRE( ready( reply ) );
+    REQUIRE( reply.get().status == DS_TIMEOUT );
+    REQUIRE( waitFor( aborts, 1 ) );
+    REQUIRE( abort_code.load() == 0x05040000u );
+
+    shutdown( master, slave, sub, co301 );
+}
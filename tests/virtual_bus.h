@@ -0,0 +1,31 @@
+#ifndef CMI_TESTS_VIRTUAL_BUS_H
+#define CMI_TESTS_VIRTUAL_BUS_H
+
+#include "cmi/CAN.h"
+#include <atomic>
+#include <thread>
+
+// The ports are connected through the virtual driver (drivers/virtual).
+inline void openVirtualBus(const char* busname, CanMoveIt::CANPortPtr* receiver, CanMoveIt::CANPortPtr* sender)
+{
+    using namespace CanMoveIt;
+    LoadCanDriver( VIRTUAL_CAN_DRIVER );
+    receiver->reset( new CANPort );
+    sender->reset( new CANPort );
+    (*receiver)->open( busname, "1M" );
+    (*sender)->open( busname, "1M" );
+}
+
+inline bool waitFor(const std::atomic<int>& counter, int value)
+{
+    using namespace CanMoveIt;
+    const TimePoint deadline = GetTimeNow() + std::chrono::seconds(5);
+    while( counter.load() < value )
+    {
+        if( GetTimeNow() > deadline ) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+#endif // CMI_TESTS_VIRTUAL_BUS_H